@@ -0,0 +1,38 @@
+#ifndef INC_CALIB_H
+#define INC_CALIB_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+#include "stdbool.h"
+
+/*DEFINES*********************************************************************************************/
+#define CALIB_MAGIC                 0x424C4143  //"CALB"
+#define CALIB_VERSION               1
+#define CALIB_CHANNELS              3           //ADC inputs 0..2 (ADC_PIN_CH_1..3)
+#define CALIB_POINTS                64          //DAC codes per calibration sweep
+#define CALIB_AVERAGE               16          //Conversions per point, the sum is the reading in Q4
+#define CALIB_INL_SHIFT             7
+#define CALIB_INL_NODES             ((4096 >> CALIB_INL_SHIFT)+1)
+#define CALIB_MAX_CODE              4095
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    int32_t offset;                             //Q4 codes
+    int32_t gain;                               //Q16.16
+    int16_t inl[CALIB_INL_NODES];               //Q4 codes, at raw codes n << CALIB_INL_SHIFT
+    bool valid;
+}calib_channel_t;
+
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    calib_channel_t channel[CALIB_CHANNELS];
+    uint32_t checksum;
+}calib_table_t;
+
+/*PROTOTYPES******************************************************************************************/
+bool calib_fit(calib_channel_t *cal, const uint16_t *ideal, const uint32_t *raw, uint16_t n);
+void calib_apply(uint16_t *buffer, uint32_t len, uint8_t channels, const calib_channel_t *cal);
+uint32_t calib_checksum(const calib_table_t *table);
+bool calib_check(const calib_table_t *table);
+
+#endif
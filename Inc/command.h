@@ -0,0 +1,20 @@
+#ifndef INC_COMMAND_H
+#define INC_COMMAND_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+#include "stdbool.h"
+
+/*DEFINES*********************************************************************************************/
+#define COMMAND_MAX_ARGS            8
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    char cmd;
+    uint8_t argc;
+    uint32_t argv[COMMAND_MAX_ARGS];
+}command_t;
+
+/*PROTOTYPES******************************************************************************************/
+bool command_parse(command_t *command, const char *frame);
+
+#endif
@@ -1,8 +1,6 @@
 #ifndef INC_DAC_H
 #define INC_DAC_H
 /*INCLUDES********************************************************************************************/
-#include "hardware/i2c.h"
-
 #include "stdint.h"
 
 /*DEFINES*********************************************************************************************/
@@ -18,10 +16,6 @@
 #define DAC_2_DIR                   0x61
 #define DAC_MEM_DIR                 0x60
 
-#define PERIOD_US                   40000
-#define ELAPCED_US                  200
-#define DAC_SIZE_BUFFER             (PERIOD_US/ELAPCED_US) +1
-
 /*PROTOTYPES**************************************************************************************/
 void dac_set_value(uint8_t dir, uint16_t value);
 
@@ -0,0 +1,50 @@
+#ifndef INC_FRAME_H
+#define INC_FRAME_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+#include "stdbool.h"
+
+/*DEFINES*********************************************************************************************/
+#define FRAME_HEADER_MAX_SIZE       16
+#define FRAME_TAIL_SIZE             3
+#define FRAME_PACKED_SIZE(n)        ((((n)+1)/2)*3)
+#define FRAME_ADC_MAX_SIZE(n)       (FRAME_HEADER_MAX_SIZE+FRAME_PACKED_SIZE(n)+FRAME_TAIL_SIZE)
+#define FRAME_RX_MAX_SIZE           50
+#define FRAME_UNITS_SIZE(n)         ((n)*2)
+#define FRAME_RICE_BLOCK            32          //Samples per channel sharing one Rice parameter
+#define FRAME_RICE_ESCAPE           16          //Quotient that escapes to a raw 13-bit value
+#define FRAME_RICE_MAX_K            12
+
+/*TYPEDEFS********************************************************************************************/
+typedef enum{
+    FRAME_RX_PENDING,
+    FRAME_RX_COMPLETE,
+    FRAME_RX_OVERFLOW
+}frame_rx_status_t;
+
+typedef enum{
+    FRAME_FORMAT_PACKED     = 0,
+    FRAME_FORMAT_RICE       = 1
+}frame_format_t;
+
+typedef struct{
+    char buffer[FRAME_RX_MAX_SIZE];
+    uint8_t index;
+}frame_rx_t;
+
+/*PROTOTYPES******************************************************************************************/
+uint32_t frame_pack_samples(uint8_t *dst, const uint16_t *src, uint32_t n);
+uint32_t frame_build_adc(uint8_t *dst, const uint16_t *src, uint32_t n, char curve_type);
+uint32_t frame_rice_encode(uint8_t *dst, uint32_t max, const uint16_t *src, uint32_t n, uint8_t channels);
+uint32_t frame_build_adc_rice(uint8_t *dst, const uint16_t *src, uint32_t n, uint8_t channels,
+                                char curve_type);
+uint32_t frame_build_bytes_header(uint8_t *dst, uint32_t n, char curve_type);
+uint32_t frame_build_units(uint8_t *dst, const uint16_t *src, uint32_t n, char curve_type);
+uint32_t frame_build_family_header(uint8_t *dst, uint16_t count, uint32_t n);
+uint32_t frame_build_family_curve(uint8_t *dst, uint8_t code, const uint16_t *src, uint32_t n, bool last);
+frame_rx_status_t frame_rx_feed(frame_rx_t *frame, char c);
+
+/*GLOBAL VARIABLES************************************************************************************/
+extern const uint8_t frame_tail[FRAME_TAIL_SIZE];
+
+#endif
@@ -3,4 +3,4 @@
 
 /*GLOBAL VARIABLES************************************************************************************/
 extern const uint8_t ico[518];
-extern const float IB_MEASSURE_VALUES[];
\ No newline at end of file
+extern const uint32_t IB_MEASSURE_NA[256];
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef INC_HAL_H
+#define INC_HAL_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+#include "stdbool.h"
+
+/*DEFINES*********************************************************************************************/
+#ifndef HAL_SIM
+#define HAL_SIM                     0           //1: Linux simulation backend (Scr/hal_sim.c)
+#endif
+
+#define HAL_ADC_MAX_CODE            4095
+#define HAL_ADC_FIRST_PIN           26          //ADC channel n is GPIO 26+n
+#define HAL_DAC_STREAM_STOP         0x200       //Stream word flag, STOP after this byte (IC_DATA_CMD)
+#define HAL_DAC_STREAM_DIVIDER(sys_mhz, step_us)    ((sys_mhz)*(step_us)/2)     //Pacing timer Y, X = 1
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    uint32_t i2c_bytes;
+    uint32_t spi_bytes;
+    uint32_t adc_samples;
+    uint32_t uart_tx_bytes;
+    uint32_t uart_rx_bytes;
+    uint64_t time_us;
+}hal_stats_t;
+
+#if HAL_SIM
+typedef struct{
+    uint64_t time_us;
+    uint8_t addr;
+    uint16_t code;
+}hal_sim_dac_update_t;
+#endif
+
+/*PROTOTYPES******************************************************************************************/
+//Byte level I/O of the drivers and the timer paced DAC stream. DMA captures, the ADC FIFO/round robin
+//and core1 stay on the pico-sdk in main.c, so the simulation backend runs the drivers and modules on a
+//host (test/), not whole sweeps
+void hal_init();
+int hal_i2c_write(uint8_t addr, const uint8_t *src, uint16_t len);
+bool hal_i2c_probe(uint8_t addr, uint32_t timeout_us);
+void hal_spi_write(const uint8_t *src, uint16_t len);
+void hal_gpio_put(uint8_t pin, bool value);
+void hal_adc_select(uint8_t channel);
+uint16_t hal_adc_read();
+bool hal_uart_readable();
+uint8_t hal_uart_getc();
+void hal_uart_write(const uint8_t *src, uint32_t len);
+uint32_t hal_time_us();
+void hal_delay_us(uint32_t us);
+hal_stats_t hal_get_stats();
+void hal_dac_stream_init(uint32_t step_us);
+void hal_dac_stream_set_step(uint32_t step_us);
+void hal_dac_stream_start(uint8_t addr, const uint16_t *stream, uint32_t words);
+uint32_t hal_dac_stream_remaining();
+void hal_dac_stream_wait();
+#if HAL_SIM
+uint32_t hal_sim_dac_updates(hal_sim_dac_update_t *dst, uint32_t max);
+#endif
+
+#endif
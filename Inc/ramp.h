@@ -0,0 +1,25 @@
+#ifndef INC_RAMP_H
+#define INC_RAMP_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+
+/*DEFINES*********************************************************************************************/
+#define RAMP_MAX_CODE               4095
+#define RAMP_ADAPT_MAX_POINTS       32          //Coarse points accepted by ramp_adaptive
+
+/*TYPEDEFS********************************************************************************************/
+typedef enum{
+    RAMP_LINEAR         = 0,
+    RAMP_LOG            = 1,
+    RAMP_STAIR          = 2,
+    RAMP_TRIANGLE       = 3
+}ramp_profile_t;
+
+/*PROTOTYPES******************************************************************************************/
+void ramp_generate(uint16_t *values, uint16_t len, uint16_t amplitude, ramp_profile_t profile,
+                        uint16_t stairs);
+uint16_t ramp_adaptive(uint16_t *values, uint16_t len, const uint16_t *codes, const uint16_t *level,
+                        uint16_t n);
+uint32_t ramp_dac_stream(uint16_t *stream, const uint16_t *values, uint16_t len);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef INC_REDUCE_H
+#define INC_REDUCE_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+
+/*DEFINES*********************************************************************************************/
+#define REDUCE_MAX_CHANNELS         4
+#define REDUCE_SAMPLE_MASK          0x0FFF      //Drop ADC FIFO error flag
+
+/*TYPEDEFS********************************************************************************************/
+typedef enum{
+    REDUCE_AVERAGE      = 0,
+    REDUCE_ENVELOPE     = 1,
+    REDUCE_DECIMATE     = 2
+}reduce_mode_t;
+
+/*PROTOTYPES******************************************************************************************/
+uint32_t reduce_samples(uint16_t *buffer, uint32_t len, uint8_t channels, uint16_t points,
+                            reduce_mode_t mode);
+uint32_t reduce_output_size(uint32_t len, uint8_t channels, uint16_t points, reduce_mode_t mode);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef INC_RING_H
+#define INC_RING_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+#include "stdbool.h"
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    uint8_t *buffer;
+    uint16_t mask;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+}ring_t;
+
+/*PROTOTYPES******************************************************************************************/
+void ring_init(ring_t *ring, uint8_t *buffer, uint16_t size);
+bool ring_put(ring_t *ring, uint8_t data);
+bool ring_get(ring_t *ring, uint8_t *data);
+uint16_t ring_count(ring_t *ring);
+
+#endif
@@ -1,9 +1,8 @@
 #ifndef INC_SCREEN_H
 #define INC_SCREEN_H
 /*INCLUDES********************************************************************************************/
-#include "hardware/i2c.h"
-
 #include "stdint.h"
+#include "stdbool.h"
 
 /*DEFINES*********************************************************************************************/
 #ifndef I2C_BUS
@@ -27,6 +26,8 @@
 #define OLED_PAGE_SIZE              8
 #define OLED_HEIGHT_SIZE            64
 #define OLED_WIDTH_SIZE             128
+#define OLED_COLUMN_OFFSET          0           //2 for SH1106 132 column RAM
+#define OLED_TX_BUFFER_SIZE         (OLED_ROW_SIZE+7)
 
 /*TYPEDEFS********************************************************************************************/
 typedef enum{
@@ -61,6 +62,7 @@ typedef enum{
 /*PROTOTYPES*******************************************************************************************/
 void oled_init();
 void oled_refresh();
+void oled_flush();
 void oled_set_contrast(uint8_t contrast);
 void oled_set_display_on(bool on);
 void oled_set_horizontal_scroll(scroll_dir_t dir, oled_page_t start, oled_page_t end,
@@ -70,7 +72,9 @@ void oled_set_pixel(uint8_t x, uint8_t y);
 void oled_reset_pixel(uint8_t x, uint8_t y);
 void oled_clear();
 void oled_draw_string(char *str, uint8_t x, uint8_t y);
-void oled_draw_bitmap(const uint8_t bitmap, uint8_t x, uint8_t y, uint8_t width, uint16_t size);
+void oled_draw_bitmap(const uint8_t *bitmap, uint8_t x, uint8_t y, uint8_t width, uint16_t size);
 void oled_draw_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void oled_draw_line(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void oled_fill_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, bool set);
 
 #endif
\ No newline at end of file
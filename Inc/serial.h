@@ -3,6 +3,8 @@
 /*INCLUDES********************************************************************************************/
 #include "hardware/uart.h"
 
+#include "command.h"
+
 /*DEFINES*********************************************************************************************/
 #ifndef UART_BUS
 #define UART_BUS
@@ -15,16 +17,7 @@
 #define MAX_SIZE_BUFFER_RX          50
 #define MAX_SIZE_BUFFER_TX          25
 #define UART_MAX_TIMEOUT            10
-
-/*TYPEDEFS******************************************************************************************/
-typedef struct{
-    char cmd;
-#ifndef MAX_SIZE_INSTRUCTION_ARG
-#define MAX_SIZE_INSTRUCTION_ARG    40
-#endif
-    char arg[MAX_SIZE_INSTRUCTION_ARG];
-
-}instruction_t;
+#define UART_RX_RING_SIZE           256
 
 /*PROTOTYPES****************************************************************************************/
 void serial_init();
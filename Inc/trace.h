@@ -0,0 +1,49 @@
+#ifndef INC_TRACE_H
+#define INC_TRACE_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+#include "stdbool.h"
+
+/*DEFINES*********************************************************************************************/
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE                1
+#endif
+
+#define TRACE_RING_SIZE             256         //Last durations kept per event, power of two
+#define TRACE_BUCKET_US             2           //Histogram resolution for p99
+#define TRACE_SETTLE_BUCKET_US      256         //TRACE_FRONT_SETTLE resolution, relay and op-amp settle in ms
+#define TRACE_BUCKETS               128         //Longer durations fall in the last bucket
+
+#if TRACE_ENABLE
+#define TRACE_RECORD(event, us)     trace_record(event, us)
+#else
+#define TRACE_RECORD(event, us)
+#endif
+
+/*TYPEDEFS********************************************************************************************/
+typedef enum{
+    TRACE_STEP_LATE     = 0,        //Step start after its scheduled time
+    TRACE_STEP_BUSY     = 1,        //DAC write to end of step work, margin against the step period
+    TRACE_DAC_WRITE     = 2,        //Blocking I2C write of one DAC code
+    TRACE_ADC_BURST     = 3,        //Synchronized mode burst DMA
+    TRACE_UART_RX_ISR   = 4,
+    TRACE_DMA_ISR       = 5,
+    TRACE_SIO_ISR       = 6,
+    TRACE_FRONT_SETTLE  = 7,        //Relay, gain and op-amp switch until the ADC reading is stable
+    TRACE_EVENTS
+}trace_event_t;
+
+typedef struct{
+    uint32_t count;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t max;
+    uint32_t p99;
+}trace_stats_t;
+
+/*PROTOTYPES******************************************************************************************/
+void trace_record(trace_event_t event, uint32_t us);
+bool trace_get_stats(trace_event_t event, trace_stats_t *stats);
+void trace_reset();
+
+#endif
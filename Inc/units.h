@@ -0,0 +1,21 @@
+#ifndef INC_UNITS_H
+#define INC_UNITS_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+
+/*DEFINES*********************************************************************************************/
+#define UNITS_SCALE_SHIFT           16          //scale is Q16.16
+#define UNITS_CHANNELS              2
+#define UNITS_GAINS                 2           //GAIN_PIN low and high
+#define UNITS_MAX_VALUE             0xFFFF
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    int32_t scale;
+    int32_t offset;
+}units_cal_t;
+
+/*PROTOTYPES******************************************************************************************/
+void units_convert(uint16_t *buffer, uint32_t len, uint8_t channels, const units_cal_t *cal);
+
+#endif
@@ -0,0 +1,165 @@
+/*INCLUDES********************************************************************************************/
+#include "calib.h"
+
+/*PROTOTYPES******************************************************************************************/
+static int32_t calib_linear(const calib_channel_t *cal, int32_t raw_q4);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Offset and gain correction of a reading.
+ *
+ *  \param  cal         Pointer to channel calibration.
+ *  \param  raw_q4      Reading in Q4 codes.
+ *
+ *  \return Corrected reading in Q4 codes, without INL.
+ *
+ */
+static int32_t calib_linear(const calib_channel_t *cal, int32_t raw_q4)
+{
+    return ((int64_t)(raw_q4 - cal->offset)*cal->gain) >> 16;
+}
+
+/*  \brief  Fit channel calibration from a sweep through the loopback path.
+ *          Least squares line raw = a*ideal + b over the points off the rails, then the residual
+ *          of each point is interpolated at the INL nodes.
+ *
+ *  \param  cal         Pointer to output.
+ *  \param  ideal       Expected code of each point (DAC code through the loopback), increasing.
+ *  \param  raw         Reading of each point in Q4 codes (sum of CALIB_AVERAGE conversions).
+ *  \param  n           Number of points (up to CALIB_POINTS).
+ *
+ *  \return false if too few points are off the rails or the readings do not increase.
+ *
+ */
+bool calib_fit(calib_channel_t *cal, const uint16_t *ideal, const uint32_t *raw, uint16_t n)
+{
+    int64_t sx = 0, sy = 0, sxx = 0, sxy = 0, num, den;
+    int32_t residual[CALIB_POINTS];
+    int32_t node, x0, x1;
+    uint16_t used = 0, first = n, last = 0, k;
+
+    cal->valid = false;
+    if(n > CALIB_POINTS)
+        return false;
+
+    for(k=0; k<n; k++)
+    {
+        //Rails clip, a reading within 8 codes of them is not used
+        if(raw[k] < 8*16 || raw[k] > (CALIB_MAX_CODE-8)*16)
+            continue;
+        if(used && raw[k] <= raw[last])
+            return false;
+
+        sx += ideal[k];
+        sy += raw[k];
+        sxx += (int64_t)ideal[k]*ideal[k];
+        sxy += (int64_t)ideal[k]*raw[k];
+        if(first == n)
+            first = k;
+        last = k;
+        used++;
+    }
+
+    if(used < 4)
+        return false;
+
+    //raw_q4 = (num/den)*ideal + b, ideal_q4 = 16*(den/num)*(raw_q4 - b)
+    num = used*sxy - sx*sy;
+    den = used*sxx - sx*sx;
+    if(num <= 0 || den <= 0)
+        return false;
+
+    cal->gain = (den << 20)/num;
+    cal->offset = (sy*den - num*sx)/(used*den);
+
+    for(k=first; k<=last; k++)
+        residual[k] = ideal[k]*16 - calib_linear(cal, raw[k]);
+
+    //Nodes outside the measured span keep the nearest residual
+    k = first;
+    for(uint16_t j=0; j<CALIB_INL_NODES; j++)
+    {
+        node = (j << CALIB_INL_SHIFT)*16;
+
+        while(k < last && (int32_t)raw[k+1] <= node)
+            k++;
+
+        if(node <= (int32_t)raw[first])
+            cal->inl[j] = residual[first];
+        else if(k >= last)
+            cal->inl[j] = residual[last];
+        else
+        {
+            x0 = raw[k];
+            x1 = raw[k+1];
+            cal->inl[j] = residual[k] + (int64_t)(residual[k+1]-residual[k])*(node-x0)/(x1-x0);
+        }
+    }
+
+    cal->valid = true;
+    return true;
+}
+
+/*  \brief  Correct interleaved 12-bit captures in place: offset, gain and interpolated INL.
+ *          One multiply and one table read per sample, output stays in 0..CALIB_MAX_CODE.
+ *
+ *  \param  buffer      Pointer to samples.
+ *  \param  len         Number of samples (all channels).
+ *  \param  channels    Number of interleaved channels.
+ *  \param  cal         Pointer to calibration of each interleaved channel, invalid ones are skipped.
+ *
+ */
+void calib_apply(uint16_t *buffer, uint32_t len, uint8_t channels, const calib_channel_t *cal)
+{
+    const calib_channel_t *c;
+    int32_t raw, value, seg, frac;
+
+    for(uint8_t ch=0; ch<channels; ch++)
+    {
+        c = &cal[ch];
+        if(!c->valid)
+            continue;
+
+        for(uint32_t i=ch; i<len; i+=channels)
+        {
+            raw = buffer[i] & 0x0FFF;
+            seg = raw >> CALIB_INL_SHIFT;
+            frac = raw & ((1 << CALIB_INL_SHIFT)-1);
+
+            value = calib_linear(c, raw << 4) + c->inl[seg] +
+                        (((c->inl[seg+1] - c->inl[seg])*frac) >> CALIB_INL_SHIFT);
+            value = (value + 8) >> 4;
+
+            if(value < 0)
+                value = 0;
+            else if(value > CALIB_MAX_CODE)
+                value = CALIB_MAX_CODE;
+
+            buffer[i] = value;
+        }
+    }
+}
+
+/*  \brief  Word sum of the table without the checksum field.
+ */
+uint32_t calib_checksum(const calib_table_t *table)
+{
+    const uint32_t *word = (const uint32_t *)table;
+    uint32_t sum = 0;
+
+    for(uint32_t i=0; i<(sizeof(calib_table_t)-sizeof(uint32_t))/sizeof(uint32_t); i++)
+        sum = (sum << 1 | sum >> 31) + word[i];
+
+    return sum;
+}
+
+/*  \brief  Check a table loaded from flash (erased flash reads all ones).
+ *
+ *  \return true if magic, version and checksum match.
+ *
+ */
+bool calib_check(const calib_table_t *table)
+{
+    return table->magic == CALIB_MAGIC && table->version == CALIB_VERSION &&
+            table->checksum == calib_checksum(table);
+}
@@ -0,0 +1,123 @@
+/*INCLUDES********************************************************************************************/
+#include "command.h"
+
+/*TYPEDEFS********************************************************************************************/
+typedef enum{
+    PARSE_Q,
+    PARSE_T,
+    PARSE_COLON,
+    PARSE_LEN_FIRST,
+    PARSE_LEN,
+    PARSE_CMD,
+    PARSE_COMMA,
+    PARSE_ARG_FIRST,
+    PARSE_ARG
+}parse_state_t;
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Parse "QT:<len>;<cmd>[,<n>[-<n>...]]." frame in one pass, without copying.
+ *          <len> counts the characters between ';' and '.', every <n> is a decimal field.
+ *
+ *  \param  command     Pointer to store decoded command.
+ *  \param  frame       Pointer to null terminated frame.
+ *
+ *  \return True if frame is well formed and fits in command.
+ *
+ */
+bool command_parse(command_t *command, const char *frame)
+{
+    parse_state_t state = PARSE_Q;
+    uint32_t len = 0;
+    uint32_t count = 0;
+    uint32_t value = 0;
+    char c;
+
+    command->argc = 0;
+
+    for(; (c = *frame) != '\0'; frame++)
+    {
+        if(state >= PARSE_CMD)
+            count++;
+
+        switch(state)
+        {
+            case PARSE_Q:
+                if(c != 'Q')
+                    return false;
+                state = PARSE_T;
+                break;
+
+            case PARSE_T:
+                if(c != 'T')
+                    return false;
+                state = PARSE_COLON;
+                break;
+
+            case PARSE_COLON:
+                if(c != ':')
+                    return false;
+                state = PARSE_LEN_FIRST;
+                break;
+
+            case PARSE_LEN_FIRST:
+            case PARSE_LEN:
+                if(c >= '0' && c <= '9' && len < 1000)
+                {
+                    len = len*10 + (c-'0');
+                    state = PARSE_LEN;
+                }
+                else if(c == ';' && state == PARSE_LEN)
+                    state = PARSE_CMD;
+                else
+                    return false;
+                break;
+
+            case PARSE_CMD:
+                if(c == '.' || c == ',')
+                    return false;
+                command->cmd = c;
+                state = PARSE_COMMA;
+                break;
+
+            case PARSE_COMMA:
+                if(c == '.')
+                    return count-1 == len;
+                if(c != ',')
+                    return false;
+                state = PARSE_ARG_FIRST;
+                break;
+
+            case PARSE_ARG_FIRST:
+            case PARSE_ARG:
+                if(c >= '0' && c <= '9')
+                {
+                    //Exact bound per digit, 4294967295 still fits
+                    if(value > (0xFFFFFFFF - (uint32_t)(c-'0'))/10)
+                        return false;
+                    value = value*10 + (c-'0');
+                    state = PARSE_ARG;
+                    break;
+                }
+
+                if(state != PARSE_ARG || (c != '-' && c != '.'))
+                    return false;
+                if(command->argc >= COMMAND_MAX_ARGS)
+                    return false;
+
+                command->argv[command->argc++] = value;
+                value = 0;
+
+                if(c == '.')
+                    return count-1 == len;
+
+                state = PARSE_ARG_FIRST;
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return false;
+}
@@ -1,9 +1,10 @@
 /*INCLUDES*****************************************************************************************/
 #include "dac.h"
+#include "hal.h"
 
 /*FUNCTIONS****************************************************************************************/
 void dac_set_value(uint8_t dir, uint16_t value)
 {
     uint8_t buffer[2] ={value>>8, value};
-    i2c_write_blocking(I2C_PORT, dir, buffer, 2, false);
+    hal_i2c_write(dir, buffer, 2);
 }
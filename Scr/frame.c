@@ -0,0 +1,346 @@
+/*INCLUDES********************************************************************************************/
+#include "stdio.h"
+#include "string.h"
+
+#include "frame.h"
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    uint8_t *dst;
+    uint32_t max;
+    uint32_t size;
+    uint32_t acc;
+    uint8_t bits;
+}bit_writer_t;
+
+/*GLOBAL VARIABLES************************************************************************************/
+const uint8_t frame_tail[FRAME_TAIL_SIZE] = {'e', 'n', 'd'};
+
+/*PROTOTYPES******************************************************************************************/
+static bool bit_write(bit_writer_t *w, uint32_t value, uint8_t bits);
+static uint8_t rice_parameter(uint32_t sum, uint32_t count);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Pack 12-bit samples in pairs of 3 bytes: [a7..a0][a11..a8 b11..b8][b7..b0].
+ *
+ *  \param  dst     Pointer to output buffer, at least FRAME_PACKED_SIZE(n) bytes.
+ *  \param  src     Pointer to samples.
+ *  \param  n       Number of samples, odd counts are padded with a zero sample.
+ *
+ *  \return Number of bytes written.
+ *
+ */
+uint32_t frame_pack_samples(uint8_t *dst, const uint16_t *src, uint32_t n)
+{
+    uint32_t k=0;
+    uint16_t a, b;
+
+    for(uint32_t i=0; i<n; i+=2)
+    {
+        a = src[i];
+        b = (i+1<n) ? src[i+1] : 0;
+
+        dst[k++] = a;
+        dst[k++] = (a>>4 & 0xF0)|(b>>8 & 0x0F);
+        dst[k++] = b;
+    }
+
+    return k;
+}
+
+/*  \brief  Build a complete "RP:<len>;<type>,<packed samples>end" frame.
+ *
+ *  \param  dst             Pointer to output buffer, at least FRAME_ADC_MAX_SIZE(n) bytes.
+ *  \param  src             Pointer to samples.
+ *  \param  n               Number of samples.
+ *  \param  curve_type      'e' for VCE curve or 'f' for VBE curve.
+ *
+ *  \return Size of frame in bytes.
+ *
+ */
+uint32_t frame_build_adc(uint8_t *dst, const uint16_t *src, uint32_t n, char curve_type)
+{
+    uint32_t size;
+
+    size = sprintf((char *)dst, "RP:%lu;%c,", (unsigned long)(FRAME_PACKED_SIZE(n)+5), curve_type);
+    size += frame_pack_samples(&dst[size], src, n);
+    memcpy(&dst[size], "end", FRAME_TAIL_SIZE);
+
+    return size+FRAME_TAIL_SIZE;
+}
+
+/*  \brief  Append bits MSB first.
+ *
+ *  \param  w       Pointer to writer.
+ *  \param  value   Bits to write, right aligned.
+ *  \param  bits    Number of bits (up to 24).
+ *
+ *  \return false if output is full.
+ *
+ */
+static bool bit_write(bit_writer_t *w, uint32_t value, uint8_t bits)
+{
+    w->acc = w->acc << bits | (value & ((1u << bits)-1));
+    w->bits += bits;
+
+    while(w->bits >= 8)
+    {
+        if(w->size >= w->max)
+            return false;
+        w->bits -= 8;
+        w->dst[w->size++] = w->acc >> w->bits;
+    }
+
+    return true;
+}
+
+/*  \brief  Rice parameter for a block: smallest k with count*2^k >= sum.
+ *
+ *  \param  sum     Sum of zigzag deltas of block.
+ *  \param  count   Number of deltas in block.
+ *
+ *  \return k, 0 to FRAME_RICE_MAX_K.
+ *
+ */
+static uint8_t rice_parameter(uint32_t sum, uint32_t count)
+{
+    uint8_t k = 0;
+
+    while(k < FRAME_RICE_MAX_K && (count << k) < sum)
+        k++;
+
+    return k;
+}
+
+/*  \brief  Compress 12-bit samples with zigzag delta and Rice coding.
+ *
+ *          Samples are interleaved by channel, each delta is taken against the previous sample of
+ *          the same channel (0 before the first). zigzag: u = d>=0 ? 2d : -2d-1.
+ *          The stream is a sequence of blocks of FRAME_RICE_BLOCK*channels samples (last block
+ *          shorter), bits MSB first:
+ *              4 bits      k of block
+ *              per sample  q = u>>k as q one bits and a zero bit, then the k low bits of u.
+ *                          If q >= FRAME_RICE_ESCAPE: FRAME_RICE_ESCAPE one bits, then u in 13 bits.
+ *          The last byte is padded with zero bits.
+ *
+ *  \param  dst         Pointer to output.
+ *  \param  max         Size of output in bytes.
+ *  \param  src         Pointer to samples.
+ *  \param  n           Number of samples (all channels).
+ *  \param  channels    Number of interleaved channels.
+ *
+ *  \return Number of bytes written, 0 if it does not fit in max.
+ *
+ */
+uint32_t frame_rice_encode(uint8_t *dst, uint32_t max, const uint16_t *src, uint32_t n, uint8_t channels)
+{
+    bit_writer_t w = {dst, max, 0, 0, 0};
+    uint32_t block = FRAME_RICE_BLOCK*channels;
+    uint32_t end, sum, u, q;
+    int32_t d;
+    uint8_t k;
+
+    for(uint32_t start=0; start<n; start+=block)
+    {
+        end = start+block < n ? start+block : n;
+
+        //First pass over the block only picks k, deltas are cheap to compute twice
+        sum = 0;
+        for(uint32_t i=start; i<end; i++)
+        {
+            d = (int32_t)(src[i] & 0x0FFF) - (i>=channels ? (src[i-channels] & 0x0FFF) : 0);
+            sum += d >= 0 ? 2*d : -2*d-1;
+        }
+
+        k = rice_parameter(sum, end-start);
+        if(!bit_write(&w, k, 4))
+            return 0;
+
+        for(uint32_t i=start; i<end; i++)
+        {
+            d = (int32_t)(src[i] & 0x0FFF) - (i>=channels ? (src[i-channels] & 0x0FFF) : 0);
+            u = d >= 0 ? 2*d : -2*d-1;
+            q = u >> k;
+
+            if(q >= FRAME_RICE_ESCAPE)
+            {
+                if(!bit_write(&w, 0xFFFF, FRAME_RICE_ESCAPE) || !bit_write(&w, u, 13))
+                    return 0;
+                continue;
+            }
+
+            //q ones and a zero, then the remainder
+            if(!bit_write(&w, ((1u << q)-1) << 1, q+1) || !bit_write(&w, u, k))
+                return 0;
+        }
+    }
+
+    if(w.bits)
+    {
+        if(w.size >= w.max)
+            return 0;
+        w.dst[w.size++] = w.acc << (8-w.bits);
+    }
+
+    return w.size;
+}
+
+/*  \brief  Build a compressed frame "RP:<len>;<TYPE>,<channels><n lo><n hi><rice stream>end".
+ *          TYPE is the uppercase curve type, see frame_rice_encode for the stream.
+ *
+ *  \param  dst             Pointer to output buffer, at least FRAME_ADC_MAX_SIZE(n) bytes.
+ *  \param  src             Pointer to samples.
+ *  \param  n               Number of samples (up to 65535).
+ *  \param  channels        Number of interleaved channels.
+ *  \param  curve_type      'e' for VCE curve or 'f' for VBE curve.
+ *
+ *  \return Size of frame in bytes, 0 if it would not be smaller than frame_build_adc.
+ *
+ */
+uint32_t frame_build_adc_rice(uint8_t *dst, const uint16_t *src, uint32_t n, uint8_t channels,
+                                char curve_type)
+{
+    uint32_t size, header;
+
+    if(FRAME_PACKED_SIZE(n) <= 3 || n > 0xFFFF)
+        return 0;
+
+    //Stream goes after the longest header and is moved down once its length is known
+    size = frame_rice_encode(&dst[FRAME_HEADER_MAX_SIZE+3], FRAME_PACKED_SIZE(n)-3, src, n, channels);
+    if(size == 0)
+        return 0;
+
+    header = sprintf((char *)dst, "RP:%lu;%c,", (unsigned long)(size+8), curve_type-'a'+'A');
+    memmove(&dst[header+3], &dst[FRAME_HEADER_MAX_SIZE+3], size);
+    dst[header] = channels;
+    dst[header+1] = n;
+    dst[header+2] = n >> 8;
+    size += header+3;
+    memcpy(&dst[size], "end", FRAME_TAIL_SIZE);
+
+    return size+FRAME_TAIL_SIZE;
+}
+
+/*  \brief  Build header of an 8-bit frame "RP:<len>;<type>,", the caller sends the n sample bytes and
+ *          frame_tail after it.
+ *
+ *  \param  dst             Pointer to output buffer, at least FRAME_HEADER_MAX_SIZE bytes.
+ *  \param  n               Number of samples.
+ *  \param  curve_type      's' for VCE curve or 't' for VBE curve.
+ *
+ *  \return Size of header in bytes.
+ *
+ */
+uint32_t frame_build_bytes_header(uint8_t *dst, uint32_t n, char curve_type)
+{
+    return sprintf((char *)dst, "RP:%lu;%c,", (unsigned long)(n+5), curve_type);
+}
+
+/*  \brief  Build a frame of converted samples "RP:<len>;<type>,<16-bit little endian samples>end".
+ *
+ *  \param  dst             Pointer to output buffer, at least FRAME_HEADER_MAX_SIZE+FRAME_UNITS_SIZE(n)+
+ *                          FRAME_TAIL_SIZE bytes.
+ *  \param  src             Pointer to samples in engineering units.
+ *  \param  n               Number of samples.
+ *  \param  curve_type      'h' for VCE curve or 'i' for VBE curve.
+ *
+ *  \return Size of frame in bytes.
+ *
+ */
+uint32_t frame_build_units(uint8_t *dst, const uint16_t *src, uint32_t n, char curve_type)
+{
+    uint32_t size;
+
+    size = sprintf((char *)dst, "RP:%lu;%c,", (unsigned long)(FRAME_UNITS_SIZE(n)+5), curve_type);
+
+    for(uint32_t i=0; i<n; i++)
+    {
+        dst[size++] = src[i];
+        dst[size++] = src[i] >> 8;
+    }
+
+    memcpy(&dst[size], "end", FRAME_TAIL_SIZE);
+
+    return size+FRAME_TAIL_SIZE;
+}
+
+/*  \brief  Build header of a multi-curve frame "RP:<len>;g,<count>," (see frame_build_family_curve).
+ *
+ *  \param  dst         Pointer to output buffer, at least FRAME_HEADER_MAX_SIZE bytes.
+ *  \param  count       Number of curves in frame.
+ *  \param  n           Number of samples per curve.
+ *
+ *  \return Size of header in bytes.
+ *
+ */
+uint32_t frame_build_family_header(uint8_t *dst, uint16_t count, uint32_t n)
+{
+    char aux[6];
+    uint32_t len;
+
+    len = sprintf(aux, "%u", count);
+    len += 3 + count*(1+FRAME_PACKED_SIZE(n)) + FRAME_TAIL_SIZE;
+
+    return sprintf((char *)dst, "RP:%lu;g,%u,", (unsigned long)len, count);
+}
+
+/*  \brief  Build one curve of a multi-curve frame: pot code byte followed by packed samples.
+ *
+ *  \param  dst         Pointer to output buffer, at least FRAME_ADC_MAX_SIZE(n) bytes.
+ *  \param  code        Digital pot code of curve (index of IB_MEASSURE_NA).
+ *  \param  src         Pointer to samples.
+ *  \param  n           Number of samples.
+ *  \param  last        True to close the frame with "end".
+ *
+ *  \return Size of curve in bytes.
+ *
+ */
+uint32_t frame_build_family_curve(uint8_t *dst, uint8_t code, const uint16_t *src, uint32_t n, bool last)
+{
+    uint32_t size;
+
+    dst[0] = code;
+    size = 1 + frame_pack_samples(&dst[1], src, n);
+
+    if(last)
+    {
+        memcpy(&dst[size], "end", FRAME_TAIL_SIZE);
+        size += FRAME_TAIL_SIZE;
+    }
+
+    return size;
+}
+
+/*  \brief  Feed received byte to "QT:<len>;<cmd>,<args>." frame assembler.
+ *          A 'Q' always restarts the frame, so garbage before it is discarded.
+ *
+ *  \param  frame       Pointer to assembler, zero initialized.
+ *  \param  c           Received byte.
+ *
+ *  \return FRAME_RX_COMPLETE when '.' closes the frame, frame->buffer then holds it
+ *          null terminated until next byte is fed.
+ *
+ */
+frame_rx_status_t frame_rx_feed(frame_rx_t *frame, char c)
+{
+    if(c == 'Q')
+        frame->index = 0;
+
+    if(frame->index >= FRAME_RX_MAX_SIZE-1)
+    {
+        frame->index = 0;
+        return FRAME_RX_OVERFLOW;
+    }
+
+    frame->buffer[frame->index++] = c;
+
+    if(c == '.')
+    {
+        frame->buffer[frame->index] = '\0';
+        frame->index = 0;
+        return FRAME_RX_COMPLETE;
+    }
+
+    return FRAME_RX_PENDING;
+}
@@ -37,41 +37,38 @@ const static uint8_t esimeico[518] =  { 0X00,0X00,0X00,0X00,0X00,0X00,
 0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,0X00,
 };
 
-const static float IB_MEASSURE_VALUES[]={
-    766.798419,    383.3992095,    343.8735178,    300.3952569,    268.7747036,    233.201581,    213.4387352,
-    196.0474308,    180.2371542,    166.0079051,    154.1501976,    142.2924901,    133.5968379,    124.9011858,
-    117.7865613,    110.6719368,    105.1383399,    100.3952569,    94.86166008,    90.90909091,    86.95652174,
-    83.39920949,    79.84189723,    76.6798419,    73.51778656,    71.14624506,    68.77470356,    66.40316206,
-    64.03162055,    62.05533597,    60.07905138,    58.1027668,    56.52173913,    54.94071146,    53.55731225,
-    52.17391304,    50.59288538,    49.40711462,    48.22134387,    47.03557312,    45.84980237,    44.46640316,
-    43.47826087,    42.68774704,    41.69960474,    40.90909091,    39.92094862,    39.13043478,    38.33992095,
-    37.74703557,    37.1541502,    36.36363636,    35.77075099,    35.17786561,    34.38735178,    33.99209486,
-    33.39920949,    32.60869565,    32.21343874,    31.62055336,    31.22529644,    30.63241107,    30.23715415,
-    29.64426877,    29.24901186,    29.0513834,    28.45849802,    27.86561265,    27.47035573,    27.07509881,
-    26.87747036,    26.28458498,    26.08695652,    25.6916996,    25.49407115,    25.09881423,    24.70355731,
-    24.3083004,    24.11067194,    23.91304348,    23.275,    22.98765432,    22.70731707,    22.43373494,
-    22.16666667,    21.90588235,    21.65116279,    21.40229885,    21.15909091,    20.92134831,    20.68888889,
-    20.46153846,    20.23913043,    20.02150538,    19.80851064,    19.6,    19.39583333,    19.19587629,
-    19,    18.80808081,    18.62,    18.43564356,    18.25490196,    18.0776699,    17.90384615,    17.73333333,
-    17.56603774,    17.40186916,    17.24074074,    17.08256881,    16.92727273,    16.77477477,    16.625,
-    16.47787611,    16.33333333,    16.19130435,    16.05172414,    15.91452991,    15.77966102,    15.64705882,
-    15.51666667,    15.38842975,    15.26229508,    15.13821138,    15.01612903,    14.896,    14.77777778,
-    14.66141732,    14.546875,    14.43410853,    14.32307692,    14.21374046,    14.10606061,    14,
-    13.89552239,    13.79259259,    13.69117647,    13.59124088,    13.49275362,    13.39568345,    13.3,
-    13.20567376,    13.11267606,    13.02097902,    12.93055556,    12.84137931,    12.75342466,    12.66666667,
-    12.58108108,    12.4966443,    12.41333333,    12.33112583,    12.25,    12.16993464,    12.09090909,
-    12.01290323,    11.93589744,    11.85987261,    11.78481013,    11.71069182,    11.6375,    11.56521739,
-    11.49382716,    11.42331288,    11.35365854,    11.28484848,    11.21686747,    11.1497006,    11.08333333,
-    11.01775148,    10.95294118,    10.88888889,    10.8255814,    10.76300578,    10.70114943,    10.64,
-    10.57954545,    10.51977401,    10.46067416,    10.40223464,    10.34444444,    10.28729282,    10.23076923,
-    10.17486339,    10.11956522,    10.06486486,    10.01075269,    9.957219251,    9.904255319,    9.851851852,
-    9.8,    9.748691099,    9.697916667,    9.647668394,    9.597938144,    9.548717949,    9.5,    9.45177665,
-    9.404040404,    9.35678392,    9.31,    9.263681592,    9.217821782,    9.172413793,    9.12745098,    9.082926829,
-    9.038834951,    8.995169082,    8.951923077,    8.909090909,    8.866666667,    8.82464455,    8.783018868,
-    8.741784038,    8.700934579,    8.660465116,    8.62037037,    8.580645161,    8.541284404,    8.502283105,
-    8.463636364,    8.425339367,    8.387387387,    8.349775785,    8.3125,    8.275555556,    8.238938053,
-    8.202643172,    8.166666667,    8.131004367,    8.095652174,    8.060606061,    8.025862069,    7.991416309,
-    7.957264957,    7.923404255,    7.889830508,    7.856540084,    7.823529412,    7.790794979,    7.758333333,
-    7.726141079,    7.694214876,    7.66255144,    7.631147541,    7.6,    7.569105691,    7.538461538,    7.508064516,
-    7.477911647,    7.448,    7.418326693,    7.388888889,    7.359683794,    7.330708661,    7.301960784,
+//Base current of each digital pot code in nA (was float uA), no float math on the device
+const uint32_t IB_MEASSURE_NA[256]={
+     766798,  383399,  343874,  300395,  268775,  233202,  213439,  196047,
+     180237,  166008,  154150,  142292,  133597,  124901,  117787,  110672,
+     105138,  100395,   94862,   90909,   86957,   83399,   79842,   76680,
+      73518,   71146,   68775,   66403,   64032,   62055,   60079,   58103,
+      56522,   54941,   53557,   52174,   50593,   49407,   48221,   47036,
+      45850,   44466,   43478,   42688,   41700,   40909,   39921,   39130,
+      38340,   37747,   37154,   36364,   35771,   35178,   34387,   33992,
+      33399,   32609,   32213,   31621,   31225,   30632,   30237,   29644,
+      29249,   29051,   28458,   27866,   27470,   27075,   26877,   26285,
+      26087,   25692,   25494,   25099,   24704,   24308,   24111,   23913,
+      23275,   22988,   22707,   22434,   22167,   21906,   21651,   21402,
+      21159,   20921,   20689,   20462,   20239,   20022,   19809,   19600,
+      19396,   19196,   19000,   18808,   18620,   18436,   18255,   18078,
+      17904,   17733,   17566,   17402,   17241,   17083,   16927,   16775,
+      16625,   16478,   16333,   16191,   16052,   15915,   15780,   15647,
+      15517,   15388,   15262,   15138,   15016,   14896,   14778,   14661,
+      14547,   14434,   14323,   14214,   14106,   14000,   13896,   13793,
+      13691,   13591,   13493,   13396,   13300,   13206,   13113,   13021,
+      12931,   12841,   12753,   12667,   12581,   12497,   12413,   12331,
+      12250,   12170,   12091,   12013,   11936,   11860,   11785,   11711,
+      11638,   11565,   11494,   11423,   11354,   11285,   11217,   11150,
+      11083,   11018,   10953,   10889,   10826,   10763,   10701,   10640,
+      10580,   10520,   10461,   10402,   10344,   10287,   10231,   10175,
+      10120,   10065,   10011,    9957,    9904,    9852,    9800,    9749,
+       9698,    9648,    9598,    9549,    9500,    9452,    9404,    9357,
+       9310,    9264,    9218,    9172,    9127,    9083,    9039,    8995,
+       8952,    8909,    8867,    8825,    8783,    8742,    8701,    8660,
+       8620,    8581,    8541,    8502,    8464,    8425,    8387,    8350,
+       8312,    8276,    8239,    8203,    8167,    8131,    8096,    8061,
+       8026,    7991,    7957,    7923,    7890,    7857,    7824,    7791,
+       7758,    7726,    7694,    7663,    7631,    7600,    7569,    7538,
+       7508,    7478,    7448,    7418,    7389,    7360,    7331,    7302,
     };
\ No newline at end of file
@@ -0,0 +1,229 @@
+/*INCLUDES********************************************************************************************/
+#include "hal.h"
+
+#if !HAL_SIM
+#include "pico/stdlib.h"
+
+#include "hardware/adc.h"
+#include "hardware/spi.h"
+#include "hardware/uart.h"
+#include "hardware/i2c.h"
+#include "hardware/timer.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+/*DEFINES*********************************************************************************************/
+#ifndef I2C_BUS
+#define I2C_BUS
+#define I2C_PORT                    i2c0
+#define I2C_BAUD                    1000000
+#define SDA_PIN                     16
+#define SCL_PIN                     17
+#endif
+
+#ifndef UART_BUS
+#define UART_BUS
+#define UART_PORT                   uart0
+#define UART_BAUDRATE               115200
+#define UART_PIN_RX                 1
+#define UART_PIN_TX                 0
+#endif
+
+#define HAL_SPI_PORT                spi0
+#define HAL_SPI_PIN_CS              5
+
+#if HAL_DAC_STREAM_STOP != I2C_IC_DATA_CMD_STOP_BITS
+#error "HAL_DAC_STREAM_STOP must match IC_DATA_CMD STOP"
+#endif
+
+/*GLOBAL VARIABLES************************************************************************************/
+static hal_stats_t stats;
+static uint dac_dma_ch;
+static uint dac_dma_timer;
+static dma_channel_config dac_dma_config;
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Peripherals are set up by the init_* functions of main.c, nothing to do on the board.
+ */
+void hal_init()
+{
+
+}
+
+/*  \brief  Blocking I2C write ending with STOP.
+ *
+ *  \param  addr    7-bit address.
+ *  \param  src     Pointer to data.
+ *  \param  len     Number of bytes.
+ *
+ *  \return Number of bytes written, or PICO_ERROR_GENERIC if not acknowledged.
+ *
+ */
+int hal_i2c_write(uint8_t addr, const uint8_t *src, uint16_t len)
+{
+    stats.i2c_bytes += len;
+    return i2c_write_blocking(I2C_PORT, addr, src, len, false);
+}
+
+/*  \brief  Check that a device answers a one byte read.
+ *
+ *  \param  addr        7-bit address.
+ *  \param  timeout_us  Timeout of read.
+ *
+ *  \return true if device acknowledged.
+ *
+ */
+bool hal_i2c_probe(uint8_t addr, uint32_t timeout_us)
+{
+    uint8_t buffer;
+
+    return i2c_read_timeout_us(I2C_PORT, addr, &buffer, 1, true, timeout_us) > 0;
+}
+
+/*  \brief  SPI write framed by the chip select of the digital pot.
+ *
+ *  \param  src     Pointer to data.
+ *  \param  len     Number of bytes.
+ *
+ */
+void hal_spi_write(const uint8_t *src, uint16_t len)
+{
+    stats.spi_bytes += len;
+    gpio_put(HAL_SPI_PIN_CS, 0);
+    spi_write_blocking(HAL_SPI_PORT, src, len);
+    gpio_put(HAL_SPI_PIN_CS, 1);
+}
+
+void hal_gpio_put(uint8_t pin, bool value)
+{
+    gpio_put(pin, value);
+}
+
+void hal_adc_select(uint8_t channel)
+{
+    adc_select_input(channel);
+}
+
+/*  \brief  Single conversion of the selected channel.
+ *
+ *  \return 12-bit code.
+ *
+ */
+uint16_t hal_adc_read()
+{
+    stats.adc_samples++;
+    return adc_read();
+}
+
+bool hal_uart_readable()
+{
+    return uart_is_readable(UART_PORT);
+}
+
+uint8_t hal_uart_getc()
+{
+    stats.uart_rx_bytes++;
+    return uart_getc(UART_PORT);
+}
+
+/*  \brief  Blocking UART write, bulk uploads use the UART DMA channel instead.
+ *
+ *  \param  src     Pointer to data.
+ *  \param  len     Number of bytes.
+ *
+ */
+void hal_uart_write(const uint8_t *src, uint32_t len)
+{
+    stats.uart_tx_bytes += len;
+    uart_write_blocking(UART_PORT, src, len);
+}
+
+uint32_t hal_time_us()
+{
+    return time_us_32();
+}
+
+void hal_delay_us(uint32_t us)
+{
+    busy_wait_us_32(us);
+}
+
+/*  \brief  Traffic counters since boot.
+ *
+ *  \return Copy of counters, time_us is the current time.
+ *
+ */
+hal_stats_t hal_get_stats()
+{
+    hal_stats_t copy = stats;
+
+    copy.time_us = time_us_64();
+    return copy;
+}
+
+/*  \brief  Claim the pacing timer and the DMA channel that feed the I2C TX FIFO: one byte every
+ *          step_us/2, the MCP4725 updates on every second byte.
+ *
+ *  \param  step_us     Time per DAC step.
+ *
+ */
+void hal_dac_stream_init(uint32_t step_us)
+{
+    dac_dma_timer = dma_claim_unused_timer(true);
+    hal_dac_stream_set_step(step_us);
+
+    dac_dma_ch = dma_claim_unused_channel(true);
+    dac_dma_config = dma_channel_get_default_config(dac_dma_ch);
+
+    channel_config_set_transfer_data_size(&dac_dma_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&dac_dma_config, true);
+    channel_config_set_write_increment(&dac_dma_config, false);
+    channel_config_set_dreq(&dac_dma_config, dma_get_timer_dreq(dac_dma_timer));
+}
+
+void hal_dac_stream_set_step(uint32_t step_us)
+{
+    dma_timer_set_fraction(dac_dma_timer, 1, HAL_DAC_STREAM_DIVIDER(clock_get_hz(clk_sys)/1000000, step_us));
+}
+
+/*  \brief  Start a paced stream, returns at once.
+ *
+ *  \param  addr    7-bit address of the DAC.
+ *  \param  stream  IC_DATA_CMD words, HAL_DAC_STREAM_STOP on the last one.
+ *  \param  words   Number of words.
+ *
+ */
+void hal_dac_stream_start(uint8_t addr, const uint16_t *stream, uint32_t words)
+{
+    i2c_hw_t *i2c = i2c_get_hw(I2C_PORT);
+
+    i2c->enable = 0;
+    i2c->tar = addr;
+    i2c->enable = 1;
+
+    stats.i2c_bytes += words;
+    dma_channel_configure(dac_dma_ch, &dac_dma_config, &i2c->data_cmd, stream, words, true);
+}
+
+/*  \brief  Words not yet moved to the I2C TX FIFO.
+ */
+uint32_t hal_dac_stream_remaining()
+{
+    return dma_channel_hw_addr(dac_dma_ch)->transfer_count;
+}
+
+/*  \brief  Block until the last word and its STOP have left the bus.
+ */
+void hal_dac_stream_wait()
+{
+    i2c_hw_t *i2c = i2c_get_hw(I2C_PORT);
+
+    dma_channel_wait_for_finish_blocking(dac_dma_ch);
+
+    //DMA ends when the last byte enters the TX FIFO, the STOP is still on the bus
+    while(!(i2c->status & I2C_IC_STATUS_TFE_BITS) || (i2c->status & I2C_IC_STATUS_ACTIVITY_BITS))
+        tight_loop_contents();
+}
+
+#endif
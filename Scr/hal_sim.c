@@ -0,0 +1,439 @@
+/*INCLUDES********************************************************************************************/
+#define _XOPEN_SOURCE 600       //posix_openpt, before any libc header
+
+#include "hal.h"
+
+#if HAL_SIM
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "fcntl.h"
+#include "unistd.h"
+
+/*DEFINES*********************************************************************************************/
+//Board, same values as main.c
+#define SIM_DAC_1_DIR               0x60        //VCE supply
+#define SIM_DAC_2_DIR               0x61        //VBE supply
+#define SIM_OLED_DIR                60
+#define SIM_RELE_PIN                15
+#define SIM_GAIN_PIN                18
+#define SIM_OPA_ENA_PIN             21
+#define SIM_POT_WRITE_CMD           0x11
+
+//Analog front end
+#define SIM_VREF                    3.3         //DAC and ADC reference
+#define SIM_VCC_GAIN                3.0         //DAC1 to collector supply
+#define SIM_RC_OHMS                 100.0
+#define SIM_RB_OHMS                 1000.0      //DAC2 to base in VBE mode
+#define SIM_VBB                     3.3         //Base supply through the pot in VCE mode
+#define SIM_POT_OHMS                100000.0
+#define SIM_POT_WIPER_OHMS          75.0
+#define SIM_VCE_DIV                 3.0         //VCE divider before ADC channel 0
+#define SIM_SENSE_OHMS              1.0         //IC (VCE mode) or IB (VBE mode) shunt, ADC channel 1
+#define SIM_SENSE_GAIN_LOW          10.0
+#define SIM_SENSE_GAIN_HIGH         1000.0      //GAIN_PIN set, small base currents
+#define SIM_NOISE_LSB               2           //Peak to peak ADC noise
+
+//DUT, NPN small signal transistor
+#define SIM_BETA                    200.0
+#define SIM_VA                      75.0        //Early voltage
+#define SIM_IS                      1e-14
+#define SIM_VT                      0.02585
+#define SIM_VCE_SAT                 0.1         //Knee width of saturation region
+
+//Time spent by each transfer, the simulation clock is virtual so sweeps run as fast as possible
+#define SIM_I2C_BYTE_US             9           //1 MHz: 9 bits per byte
+#define SIM_ADC_SAMPLE_US           2
+#define SIM_SYS_MHZ                 130         //Clock of the DMA pacing timer, set_sys_clock_khz in main.c
+#define SIM_DAC_LOG_SIZE            2048        //Updates kept for hal_sim_dac_updates
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint16_t dac_code[2];
+static uint8_t pot_code = 255;
+static bool rele, gain, opa;
+static uint8_t adc_channel;
+static int pty = -1;
+static int16_t rx_peek = -1;
+static hal_stats_t stats;
+
+//DAC stream: word k enters the TX FIFO at start + (k+1)*period, times in ns
+static const uint16_t *stream;
+static uint32_t stream_words, stream_sent;
+static uint8_t stream_addr;
+static uint64_t stream_start_ns, stream_period_ns, bus_free_ns;
+static uint32_t stream_period_div;
+static hal_sim_dac_update_t dac_log[SIM_DAC_LOG_SIZE];
+static uint32_t dac_log_len;
+
+/*PROTOTYPES******************************************************************************************/
+static double dut_ic(double vce, double ib);
+static double solve_vce(double vcc, double ib);
+static double solve_vbe(double vb);
+static uint16_t adc_code(double volts);
+static void dac_stream_run(uint64_t now_ns);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Collector current with Early effect and a smooth saturation knee.
+ *
+ *  \param  vce     Collector emitter voltage.
+ *  \param  ib      Base current.
+ *
+ *  \return IC in A.
+ *
+ */
+static double dut_ic(double vce, double ib)
+{
+    if(vce <= 0 || ib <= 0)
+        return 0;
+
+    return SIM_BETA*ib*(1 + vce/SIM_VA)*tanh(vce/SIM_VCE_SAT);
+}
+
+/*  \brief  Operating point of the collector loop VCC = VCE + IC*RC by bisection.
+ *
+ *  \param  vcc     Collector supply.
+ *  \param  ib      Base current.
+ *
+ *  \return VCE.
+ *
+ */
+static double solve_vce(double vcc, double ib)
+{
+    double lo = 0, hi = vcc, mid = 0;
+
+    for(uint8_t i=0; i<40; i++)
+    {
+        mid = (lo+hi)/2;
+        if(mid + dut_ic(mid, ib)*SIM_RC_OHMS > vcc)
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    return mid;
+}
+
+/*  \brief  Operating point of the base loop VB = VBE + IB*RB by bisection.
+ *
+ *  \param  vb      Base supply.
+ *
+ *  \return VBE.
+ *
+ */
+static double solve_vbe(double vb)
+{
+    double lo = 0, hi = vb, mid = 0;
+
+    for(uint8_t i=0; i<40; i++)
+    {
+        mid = (lo+hi)/2;
+        if(mid + SIM_IS/SIM_BETA*(exp(mid/SIM_VT)-1)*SIM_RB_OHMS > vb)
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    return mid;
+}
+
+static uint16_t adc_code(double volts)
+{
+    int32_t code = volts/SIM_VREF*HAL_ADC_MAX_CODE + 0.5;
+
+    code += rand()%(SIM_NOISE_LSB+1) - SIM_NOISE_LSB/2;
+    if(code < 0)
+        return 0;
+    if(code > HAL_ADC_MAX_CODE)
+        return HAL_ADC_MAX_CODE;
+
+    return code;
+}
+
+/*  \brief  Open the pseudo terminal that stands for the UART, the host application connects to the
+ *          printed path. Host tests that do not use the UART can skip it.
+ */
+void hal_init()
+{
+    pty = posix_openpt(O_RDWR | O_NOCTTY);
+    if(pty < 0 || grantpt(pty) || unlockpt(pty))
+    {
+        perror("hal_sim: pty");
+        exit(1);
+    }
+
+    fcntl(pty, F_SETFL, fcntl(pty, F_GETFL) | O_NONBLOCK);
+    printf("hal_sim: UART on %s\n", ptsname(pty));
+}
+
+/*  \brief  MCP4725 fast write, repeated [0 0 PD1 PD0 D11..D8][D7..D0] pairs update the output.
+ *          The OLED accepts anything, other addresses do not acknowledge.
+ *
+ *  \return Number of bytes written, -1 if not acknowledged.
+ *
+ */
+int hal_i2c_write(uint8_t addr, const uint8_t *src, uint16_t len)
+{
+    stats.i2c_bytes += len;
+    stats.time_us += (len+1)*SIM_I2C_BYTE_US;
+
+    if(addr == SIM_OLED_DIR)
+        return len;
+    if(addr != SIM_DAC_1_DIR && addr != SIM_DAC_2_DIR)
+        return -1;
+
+    for(uint16_t i=0; i+1<len; i+=2)
+        dac_code[addr-SIM_DAC_1_DIR] = (src[i] & 0x0F) << 8 | src[i+1];
+
+    return len;
+}
+
+bool hal_i2c_probe(uint8_t addr, uint32_t timeout_us)
+{
+    (void)timeout_us;
+    stats.time_us += 2*SIM_I2C_BYTE_US;
+    return addr == SIM_DAC_1_DIR || addr == SIM_DAC_2_DIR || addr == SIM_OLED_DIR;
+}
+
+/*  \brief  MCP41xxx digital pot, only the write data command is modelled.
+ */
+void hal_spi_write(const uint8_t *src, uint16_t len)
+{
+    stats.spi_bytes += len;
+
+    if(len >= 2 && src[0] == SIM_POT_WRITE_CMD)
+        pot_code = src[1];
+}
+
+void hal_gpio_put(uint8_t pin, bool value)
+{
+    if(pin == SIM_RELE_PIN)
+        rele = value;
+    else if(pin == SIM_GAIN_PIN)
+        gain = value;
+    else if(pin == SIM_OPA_ENA_PIN)
+        opa = value;
+}
+
+void hal_adc_select(uint8_t channel)
+{
+    adc_channel = channel;
+}
+
+/*  \brief  Convert the selected channel from the DUT operating point.
+ *          Relay off (VCE mode): 0 VCE/SIM_VCE_DIV, 1 IC sense, 2 base supply.
+ *          Relay on (VBE mode): 0 VCE/SIM_VCE_DIV, 1 IB sense, 2 VBE.
+ *
+ *  \return 12-bit code.
+ *
+ */
+uint16_t hal_adc_read()
+{
+    double vcc, vb, vbe, ib, vce, sense;
+    double amp = gain ? SIM_SENSE_GAIN_HIGH : SIM_SENSE_GAIN_LOW;
+
+    stats.adc_samples++;
+    stats.time_us += SIM_ADC_SAMPLE_US;
+    dac_stream_run(stats.time_us*1000);
+
+    if(!opa)
+        return adc_code(0);
+
+    if(!rele)
+    {
+        vcc = dac_code[0]*SIM_VREF/HAL_ADC_MAX_CODE*SIM_VCC_GAIN;
+        ib = (SIM_VBB-0.7)/(pot_code*SIM_POT_OHMS/256 + SIM_POT_WIPER_OHMS);
+        vce = solve_vce(vcc, ib);
+        sense = dut_ic(vce, ib)*SIM_SENSE_OHMS*amp;
+        vbe = 0.7;
+    }
+    else
+    {
+        vb = dac_code[1]*SIM_VREF/HAL_ADC_MAX_CODE;
+        vbe = solve_vbe(vb);
+        ib = (vb-vbe)/SIM_RB_OHMS;
+        vce = vbe;
+        sense = ib*SIM_SENSE_OHMS*amp;
+    }
+
+    switch(adc_channel)
+    {
+        case 0:
+            return adc_code(vce/SIM_VCE_DIV);
+        case 1:
+            return adc_code(sense);
+        default:
+            return adc_code(rele ? vbe : SIM_VBB);
+    }
+}
+
+bool hal_uart_readable()
+{
+    uint8_t c;
+
+    //One byte look ahead, the pty has no "bytes available" query that works everywhere
+    if(rx_peek < 0 && pty >= 0 && read(pty, &c, 1) == 1)
+        rx_peek = c;
+
+    return rx_peek >= 0;
+}
+
+uint8_t hal_uart_getc()
+{
+    uint8_t c;
+
+    while(!hal_uart_readable())
+        usleep(100);
+
+    c = rx_peek;
+    rx_peek = -1;
+    stats.uart_rx_bytes++;
+    return c;
+}
+
+void hal_uart_write(const uint8_t *src, uint32_t len)
+{
+    ssize_t n;
+
+    //Without hal_init (host tests) there is no pty, output is counted and dropped
+    stats.uart_tx_bytes += len;
+    if(pty < 0)
+        return;
+
+    while(len)
+    {
+        n = write(pty, src, len);
+        if(n <= 0)
+        {
+            usleep(100);
+            continue;
+        }
+        src += n;
+        len -= n;
+    }
+}
+
+/*  \brief  Virtual clock, every read costs 1 us so polled waits always end.
+ */
+uint32_t hal_time_us()
+{
+    return stats.time_us++;
+}
+
+/*  \brief  Advance the virtual clock, a full 40 ms sweep takes only the model evaluation time.
+ */
+void hal_delay_us(uint32_t us)
+{
+    stats.time_us += us;
+}
+
+hal_stats_t hal_get_stats()
+{
+    return stats;
+}
+
+/*  \brief  Move the stream words due by now_ns to the bus. Bytes go out back to back at
+ *          SIM_I2C_BYTE_US after the address byte, the DAC output changes when the second byte of a
+ *          pair completes.
+ *
+ *  \param  now_ns  Virtual time in ns.
+ *
+ */
+static void dac_stream_run(uint64_t now_ns)
+{
+    uint64_t fifo_ns, done_ns;
+    uint16_t word;
+
+    while(stream_sent < stream_words)
+    {
+        fifo_ns = stream_start_ns + (uint64_t)(stream_sent+1)*stream_period_ns;
+        done_ns = (fifo_ns > bus_free_ns ? fifo_ns : bus_free_ns) + SIM_I2C_BYTE_US*1000;
+        if(done_ns > now_ns)
+            return;
+
+        word = stream[stream_sent];
+        bus_free_ns = done_ns;
+        stats.i2c_bytes++;
+
+        if(stream_sent & 1)
+        {
+            dac_code[stream_addr-SIM_DAC_1_DIR] = (stream[stream_sent-1] & 0x0F) << 8 | (word & 0xFF);
+            if(dac_log_len < SIM_DAC_LOG_SIZE)
+            {
+                dac_log[dac_log_len].time_us = done_ns/1000;
+                dac_log[dac_log_len].addr = stream_addr;
+                dac_log[dac_log_len].code = dac_code[stream_addr-SIM_DAC_1_DIR];
+                dac_log_len++;
+            }
+        }
+
+        stream_sent++;
+    }
+}
+
+void hal_dac_stream_init(uint32_t step_us)
+{
+    hal_dac_stream_set_step(step_us);
+}
+
+/*  \brief  Same divider as the board, so truncation of odd step_us shows up in the timing.
+ */
+void hal_dac_stream_set_step(uint32_t step_us)
+{
+    stream_period_div = HAL_DAC_STREAM_DIVIDER(SIM_SYS_MHZ, step_us);
+}
+
+void hal_dac_stream_start(uint8_t addr, const uint16_t *src, uint32_t words)
+{
+    //Only the DACs are modelled, anything else is dropped like a NACK
+    stream = src;
+    stream_words = (addr == SIM_DAC_1_DIR || addr == SIM_DAC_2_DIR) ? words : 0;
+    stream_sent = 0;
+    stream_addr = addr;
+    stream_start_ns = stats.time_us*1000;
+    stream_period_ns = (uint64_t)stream_period_div*1000/SIM_SYS_MHZ;
+    bus_free_ns = stream_start_ns + SIM_I2C_BYTE_US*1000;
+    stats.i2c_bytes++;
+}
+
+uint32_t hal_dac_stream_remaining()
+{
+    uint32_t moved;
+
+    dac_stream_run(stats.time_us*1000);
+    if(!stream_period_ns || stats.time_us*1000 < stream_start_ns)
+        return stream_words;
+
+    moved = (stats.time_us*1000 - stream_start_ns)/stream_period_ns;
+    return moved < stream_words ? stream_words - moved : 0;
+}
+
+/*  \brief  Advance the virtual clock to the STOP after the last byte.
+ */
+void hal_dac_stream_wait()
+{
+    dac_stream_run(UINT64_MAX);
+    if(bus_free_ns > stats.time_us*1000)
+        stats.time_us = (bus_free_ns+999)/1000;
+}
+
+/*  \brief  Copy and clear the log of DAC updates made by streams.
+ *
+ *  \param  dst     Pointer to output.
+ *  \param  max     Size of output.
+ *
+ *  \return Number of updates copied.
+ *
+ */
+uint32_t hal_sim_dac_updates(hal_sim_dac_update_t *dst, uint32_t max)
+{
+    uint32_t len = dac_log_len < max ? dac_log_len : max;
+
+    for(uint32_t i=0; i<len; i++)
+        dst[i] = dac_log[i];
+
+    dac_log_len = 0;
+    return len;
+}
+
+#endif
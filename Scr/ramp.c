@@ -0,0 +1,258 @@
+/*INCLUDES********************************************************************************************/
+#include "ramp.h"
+#include "hal.h"
+
+/*PROTOTYPES******************************************************************************************/
+static void ramp_linear(uint16_t *values, uint16_t len, uint16_t amplitude);
+static int32_t log2_q16(uint32_t x);
+static uint32_t exp2_q16(int32_t x);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Fill linear ramp from 0 to amplitude with a Q16.16 accumulator.
+ *
+ *  \param  values      Pointer to output.
+ *  \param  len         Number of points.
+ *  \param  amplitude   Last value of ramp.
+ *
+ */
+static void ramp_linear(uint16_t *values, uint16_t len, uint16_t amplitude)
+{
+    uint32_t acc = 0x8000;
+    uint32_t step;
+
+    if(len < 2)
+    {
+        if(len)
+            values[0] = amplitude;
+        return;
+    }
+
+    step = ((uint32_t)amplitude << 16)/(len-1);
+
+    for(uint16_t i=0; i<len-1; i++)
+    {
+        values[i] = acc >> 16;
+        acc += step;
+    }
+
+    values[len-1] = amplitude;
+}
+
+/*  \brief  Base 2 logarithm in Q16.16.
+ *
+ *  \param  x       Integer value, greater than 0.
+ *
+ *  \return log2(x) in Q16.16.
+ *
+ */
+static int32_t log2_q16(uint32_t x)
+{
+    int32_t result = 0;
+    uint8_t n = 0;
+    uint64_t m;
+
+    while((x >> n) >= 2)
+        n++;
+
+    result = n << 16;
+    m = ((uint64_t)x << 16) >> n;
+
+    //Fraction bits by repeated squaring of the mantissa in [1,2)
+    for(int32_t bit = 1 << 15; bit > 0; bit >>= 1)
+    {
+        m = (m*m) >> 16;
+        if(m >= (2 << 16))
+        {
+            m >>= 1;
+            result |= bit;
+        }
+    }
+
+    return result;
+}
+
+/*  \brief  Base 2 power of Q16.16 value.
+ *
+ *  \param  x       Exponent in Q16.16, 0 to 16.
+ *
+ *  \return 2^x rounded to integer.
+ *
+ */
+static uint32_t exp2_q16(int32_t x)
+{
+    uint64_t f = x & 0xFFFF;
+    uint64_t p;
+
+    //2^f ~ 1 + 0.6951f + 0.2262f^2 + 0.0782f^3 for f in [0,1), error below 1e-3
+    p = 5125;
+    p = 14824 + ((p*f) >> 16);
+    p = 45554 + ((p*f) >> 16);
+    p = 65536 + ((p*f) >> 16);
+
+    return ((p << (x >> 16)) + 0x8000) >> 16;
+}
+
+/*  \brief  Fill DAC sweep profile using integer math only.
+ *
+ *  \param  values      Pointer to output.
+ *  \param  len         Number of points.
+ *  \param  amplitude   Peak DAC code (up to RAMP_MAX_CODE).
+ *  \param  profile     RAMP_LINEAR: 0 to amplitude.
+ *                      RAMP_LOG: 0 then log spaced from 1 to amplitude, dense at low codes.
+ *                      RAMP_STAIR: linear ramp quantized to stairs levels.
+ *                      RAMP_TRIANGLE: 0 to amplitude and back to 0 (hysteresis).
+ *  \param  stairs      Number of levels for RAMP_STAIR (at least 2).
+ *
+ */
+void ramp_generate(uint16_t *values, uint16_t len, uint16_t amplitude, ramp_profile_t profile,
+                        uint16_t stairs)
+{
+    int32_t top, acc, step;
+    uint32_t level, level_step;
+    uint16_t half;
+
+    if(amplitude > RAMP_MAX_CODE)
+        amplitude = RAMP_MAX_CODE;
+
+    switch(profile)
+    {
+        case RAMP_LOG:
+            if(len < 3 || amplitude < 2)
+            {
+                ramp_linear(values, len, amplitude);
+                break;
+            }
+
+            top = log2_q16(amplitude);
+            step = top/(len-2);
+            acc = 0;
+
+            values[0] = 0;
+            for(uint16_t i=1; i<len-1; i++)
+            {
+                values[i] = exp2_q16(acc);
+                acc += step;
+            }
+            values[len-1] = amplitude;
+            break;
+
+        case RAMP_STAIR:
+            if(stairs < 2)
+                stairs = 2;
+
+            //Level index in Q16.16 so no division is done per point
+            level_step = ((uint32_t)stairs << 16)/len;
+            level = 0;
+
+            for(uint16_t i=0; i<len; i++)
+            {
+                values[i] = (uint32_t)amplitude*(level >> 16)/(stairs-1);
+                level += level_step;
+            }
+            break;
+
+        case RAMP_TRIANGLE:
+            half = (len+1)/2;
+            ramp_linear(values, half, amplitude);
+
+            for(uint16_t i=half; i<len; i++)
+                values[i] = values[len-1-i];
+            break;
+
+        case RAMP_LINEAR:
+        default:
+            ramp_linear(values, len, amplitude);
+            break;
+    }
+}
+
+/*  \brief  Place sweep points with density following the curvature of a coarse pass.
+ *
+ *  \param  values      Pointer to output, len codes in increasing order.
+ *  \param  len         Number of points.
+ *  \param  codes       DAC codes of the coarse pass, increasing.
+ *  \param  level       Measured value (IC) at each coarse code.
+ *  \param  n           Number of coarse points (2 to RAMP_ADAPT_MAX_POINTS).
+ *
+ *  \return Number of points written, 0 if the coarse pass is not usable.
+ *
+ */
+uint16_t ramp_adaptive(uint16_t *values, uint16_t len, const uint16_t *codes, const uint16_t *level,
+                        uint16_t n)
+{
+    int32_t slope[RAMP_ADAPT_MAX_POINTS];
+    uint32_t weight[RAMP_ADAPT_MAX_POINTS];
+    uint32_t total = 0, floor, target, acc;
+    uint16_t span, j;
+
+    if(n < 2 || n > RAMP_ADAPT_MAX_POINTS || len < 2)
+        return 0;
+
+    //Slope of each coarse interval in Q8, DAC code spacing may be uneven
+    for(j=0; j<n-1; j++)
+    {
+        span = codes[j+1] - codes[j];
+        if(codes[j+1] <= codes[j])
+            return 0;
+        slope[j] = (((int32_t)level[j+1] - level[j]) << 8)/span;
+    }
+
+    //Interval weight: slope change at both ends, the knee is where dIc/dVce changes fastest
+    for(j=0; j<n-1; j++)
+    {
+        weight[j] = 0;
+        if(j > 0)
+            weight[j] += slope[j] > slope[j-1] ? slope[j]-slope[j-1] : slope[j-1]-slope[j];
+        if(j < n-2)
+            weight[j] += slope[j+1] > slope[j] ? slope[j+1]-slope[j] : slope[j]-slope[j+1];
+        total += weight[j];
+    }
+
+    //Keep a quarter of the points spread uniformly so flat regions are not left empty
+    floor = total/(4*(n-1)) + 1;
+    total = 0;
+    for(j=0; j<n-1; j++)
+    {
+        weight[j] += floor;
+        total += weight[j];
+    }
+
+    //Invert the cumulative weight: point i sits where it reaches i/(len-1) of the total
+    j = 0;
+    acc = 0;
+    for(uint16_t i=0; i<len; i++)
+    {
+        target = (uint64_t)total*i/(len-1);
+
+        while(j < n-2 && acc + weight[j] < target)
+            acc += weight[j++];
+
+        values[i] = codes[j] + (uint64_t)(codes[j+1]-codes[j])*(target-acc)/weight[j];
+    }
+
+    values[len-1] = codes[n-1];
+    return len;
+}
+
+/*  \brief  Pack a ramp as MCP4725 fast writes repeated inside one I2C transaction, one word per byte
+ *          for hal_dac_stream_start: [0 0 PD1 PD0 D11..D8][D7..D0], STOP after the last byte.
+ *
+ *  \param  stream      Pointer to output, 2*len words.
+ *  \param  values      DAC codes.
+ *  \param  len         Number of steps.
+ *
+ *  \return Number of words written.
+ *
+ */
+uint32_t ramp_dac_stream(uint16_t *stream, const uint16_t *values, uint16_t len)
+{
+    for(uint16_t i=0; i<len; i++)
+    {
+        stream[2*i] = (values[i]>>8) & 0x0F;
+        stream[2*i+1] = values[i] & 0xFF;
+    }
+
+    stream[2*len-1] |= HAL_DAC_STREAM_STOP;
+    return 2*len;
+}
@@ -0,0 +1,116 @@
+/*INCLUDES********************************************************************************************/
+#include "reduce.h"
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Size of reduced capture.
+ *
+ *  \param  len         Number of samples in capture (all channels).
+ *  \param  channels    Number of interleaved channels.
+ *  \param  points      Points per channel requested, 0 for raw capture.
+ *  \param  mode        Reduction mode.
+ *
+ *  \return Number of samples after reduction (all channels).
+ *
+ */
+uint32_t reduce_output_size(uint32_t len, uint8_t channels, uint16_t points, reduce_mode_t mode)
+{
+    uint32_t frames = len/channels;
+
+    if(points == 0 || points >= frames || channels > REDUCE_MAX_CHANNELS)
+        return len;
+
+    if(mode == REDUCE_ENVELOPE)
+    {
+        if(frames/points < 2)
+            return len;
+        return 2*points*channels;
+    }
+
+    return points*channels;
+}
+
+/*  \brief  Reduce interleaved capture in place to a number of points per channel.
+ *
+ *  \param  buffer      Pointer to capture, samples interleaved by channel.
+ *  \param  len         Number of samples in capture (all channels).
+ *  \param  channels    Number of interleaved channels.
+ *  \param  points      Points per channel, 0 for raw capture.
+ *  \param  mode        REDUCE_AVERAGE: boxcar mean of each block.
+ *                      REDUCE_ENVELOPE: min then max of each block (2 points per block).
+ *                      REDUCE_DECIMATE: center sample of each block.
+ *
+ *  \return Number of samples left in buffer (all channels).
+ *
+ */
+uint32_t reduce_samples(uint16_t *buffer, uint32_t len, uint8_t channels, uint16_t points,
+                            reduce_mode_t mode)
+{
+    uint32_t size = reduce_output_size(len, channels, points, mode);
+    uint32_t block, base;
+    uint32_t sum[REDUCE_MAX_CHANNELS];
+    uint16_t min[REDUCE_MAX_CHANNELS], max[REDUCE_MAX_CHANNELS];
+    uint16_t value;
+
+    if(size == len)
+        return len;
+
+    block = (len/channels)/points;
+
+    //Output index never passes the start of the block being read, so it works in place
+    for(uint32_t p=0; p<points; p++)
+    {
+        base = p*block*channels;
+
+        switch(mode)
+        {
+            case REDUCE_ENVELOPE:
+                for(uint8_t c=0; c<channels; c++)
+                {
+                    min[c] = 0xFFFF;
+                    max[c] = 0;
+                }
+
+                for(uint32_t k=0; k<block; k++)
+                {
+                    for(uint8_t c=0; c<channels; c++)
+                    {
+                        value = buffer[base + k*channels + c] & REDUCE_SAMPLE_MASK;
+                        if(value < min[c])
+                            min[c] = value;
+                        if(value > max[c])
+                            max[c] = value;
+                    }
+                }
+
+                for(uint8_t c=0; c<channels; c++)
+                {
+                    buffer[2*p*channels + c] = min[c];
+                    buffer[(2*p+1)*channels + c] = max[c];
+                }
+                break;
+
+            case REDUCE_DECIMATE:
+                for(uint8_t c=0; c<channels; c++)
+                    buffer[p*channels + c] = buffer[base + (block/2)*channels + c];
+                break;
+
+            case REDUCE_AVERAGE:
+            default:
+                for(uint8_t c=0; c<channels; c++)
+                    sum[c] = 0;
+
+                for(uint32_t k=0; k<block; k++)
+                {
+                    for(uint8_t c=0; c<channels; c++)
+                        sum[c] += buffer[base + k*channels + c] & REDUCE_SAMPLE_MASK;
+                }
+
+                for(uint8_t c=0; c<channels; c++)
+                    buffer[p*channels + c] = (sum[c] + block/2)/block;
+                break;
+        }
+    }
+
+    return size;
+}
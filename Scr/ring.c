@@ -0,0 +1,73 @@
+/*INCLUDES********************************************************************************************/
+#include "ring.h"
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Initialize single producer / single consumer byte ring.
+ *
+ *  \param  ring        Pointer to ring.
+ *  \param  buffer      Pointer to storage.
+ *  \param  size        Size of storage, must be power of two.
+ *
+ */
+void ring_init(ring_t *ring, uint8_t *buffer, uint16_t size)
+{
+    ring->buffer = buffer;
+    ring->mask = size-1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/*  \brief  Put byte in ring (producer side, safe from ISR).
+ *
+ *  \param  ring        Pointer to ring.
+ *  \param  data        Byte to put.
+ *
+ *  \return False if ring is full and byte was dropped.
+ *
+ */
+bool ring_put(ring_t *ring, uint8_t data)
+{
+    uint16_t head = ring->head;
+
+    if((uint16_t)(head - ring->tail) > ring->mask)
+        return false;
+
+    ring->buffer[head & ring->mask] = data;
+    ring->head = head+1;
+
+    return true;
+}
+
+/*  \brief  Get byte from ring (consumer side).
+ *
+ *  \param  ring        Pointer to ring.
+ *  \param  data        Pointer to store byte.
+ *
+ *  \return False if ring is empty.
+ *
+ */
+bool ring_get(ring_t *ring, uint8_t *data)
+{
+    uint16_t tail = ring->tail;
+
+    if(tail == ring->head)
+        return false;
+
+    *data = ring->buffer[tail & ring->mask];
+    ring->tail = tail+1;
+
+    return true;
+}
+
+/*  \brief  Number of bytes waiting in ring.
+ *
+ *  \param  ring        Pointer to ring.
+ *
+ *  \return Number of bytes.
+ *
+ */
+uint16_t ring_count(ring_t *ring)
+{
+    return (uint16_t)(ring->head - ring->tail);
+}
@@ -1,19 +1,21 @@
 /*INCLUDES********************************************************************************************/
-#include "stdarg"
-
-#include "FreeRTOS.h"
+#include "stdbool.h"
 
 #include "screen.h"
+#include "hal.h"
 #include "fonts.h"
 
 /*GLOBAL VARIABLES************************************************************************************/
 static uint8_t matrix[OLED_PAGE_SIZE][OLED_ROW_SIZE];
+static uint8_t dirty_start[OLED_PAGE_SIZE];
+static uint8_t dirty_end[OLED_PAGE_SIZE];
+static uint8_t tx_buffer[OLED_TX_BUFFER_SIZE];
 
 /*PROTOTYPES******************************************************************************************/
 static void oled_write_command(uint8_t cmd);
 static void oled_write_l_command(uint8_t *cmd, uint16_t len);
-static void oled_write_data(uint8_t data);
-static void oled_write_page(uint8_t page, uint8_t *data);
+static void oled_write_span(uint8_t page, uint8_t column, uint8_t *data, uint8_t len);
+static void oled_mark_dirty(uint8_t page, uint8_t x0, uint8_t x1);
 static uint8_t reverse(uint8_t b);
 
 /*FUNCTIONS*******************************************************************************************/
@@ -26,7 +28,7 @@ static uint8_t reverse(uint8_t b);
 static void oled_write_command(uint8_t cmd)
 {
     uint8_t buffer[2] = {0x00, cmd};
-    i2c_write_blocking(I2C_PORT, OLED_DIR, buffer, 2, false);
+    hal_i2c_write(OLED_DIR, buffer, 2);
 }
 
 /*  \brief  Write multi-command to oled screen.
@@ -37,53 +39,69 @@ static void oled_write_command(uint8_t cmd)
  */
 static void oled_write_l_command(uint8_t *cmd, uint16_t len)
 {
-    uint8_t *buffer;
+    if(len > OLED_TX_BUFFER_SIZE-1)
+        len = OLED_TX_BUFFER_SIZE-1;
 
-    buffer = pvPortMalloc(len+1);
-    buffer[0] = 0x00;
+    tx_buffer[0] = 0x00;
 
     for(uint16_t i=0; i<len; i++)
-        buffer[i+1] = cmd[i];
-
-    i2c_write_blocking(I2C_PORT, I2C_DIR_OLED, buffer, len+1, false);
+        tx_buffer[i+1] = cmd[i];
 
-    vPortFree(buffer);    
+    hal_i2c_write(OLED_DIR, tx_buffer, len+1);
 }
 
-/*  \brief  Write data to oled screen.
+/*  \brief  Write span of columns to page on screen in one transaction (see datasheet).
+ *          Address commands go with Co=1 control bytes (0x80), then 0x40 starts the data.
  *  
- *  \param  data        Data for write to screen.
+ *  \param  page        Number of page to write.
+ *  \param  column      First column of span.
+ *  \param  data        Pointer to data to write.
+ *  \param  len         Number of columns to write.
  * 
  */
-static void oled_write_data(uint8_t data)
+static void oled_write_span(uint8_t page, uint8_t column, uint8_t *data, uint8_t len)
 {
-    uint8_t buffer[2] = {0x00, data};
-    i2c_write_blocking(I2C_PORT, OLED_DIR, buffer, 2, false);    
+    column += OLED_COLUMN_OFFSET;
+
+    tx_buffer[0] = 0x80;
+    tx_buffer[1] = 0xb0 + page;
+    tx_buffer[2] = 0x80;
+    tx_buffer[3] = 0x00 | (column & 0x0F);
+    tx_buffer[4] = 0x80;
+    tx_buffer[5] = 0x10 | (column >> 4);
+    tx_buffer[6] = 0x40;
+
+	for(uint8_t i=0; i<len; i++)
+		tx_buffer[i+7] = data[i];
+
+    hal_i2c_write(OLED_DIR, tx_buffer, len+7);
 }
 
-/*  \brief  Write data to page on screen (see datasheet).
+/*  \brief  Extend dirty span of page.
  *  
- *  \param  page        Number of page to write.
- *  \param  data        Pointer to data to write.
+ *  \param  page        Number of page.
+ *  \param  x0          First changed column.
+ *  \param  x1          Last changed column (inclusive).
  * 
  */
-static void oled_write_page(uint8_t page, uint8_t *data)
+static void oled_mark_dirty(uint8_t page, uint8_t x0, uint8_t x1)
 {
-    uint8_t *buffer;
+    if(page >= OLED_PAGE_SIZE)
+        return;
+    if(x1 >= OLED_ROW_SIZE)
+        x1 = OLED_ROW_SIZE-1;
 
-    buffer = pvPortMalloc(OLED_ROW_SIZE+1)
-
-    buffer[0] = 0x40;
-	for(uint8_t i=0; i<OLED_ROW_SIZE; i++)
-		buffer[i+1] = data[i];
-
-	write_command_oled(0xb0 + page);
-	write_command_oled(0x00);
-	write_command_oled(0x10);
-
-    i2c_write_blocking(I2C_PORT, I2C_DIR_OLED, buffer, OLED_ROW_SIZE+1, false);
+    if(dirty_start[page] > dirty_end[page])
+    {
+        dirty_start[page] = x0;
+        dirty_end[page] = x1;
+        return;
+    }
 
-    vPortFree(buffer);
+    if(x0 < dirty_start[page])
+        dirty_start[page] = x0;
+    if(x1 > dirty_end[page])
+        dirty_end[page] = x1;
 }
 
 /*  \brief  Invert bits of byte.
@@ -101,11 +119,18 @@ static uint8_t reverse(uint8_t b)
     return b;
 }
 
-/*  \brief  Initialize screen.
+/*  \brief  Initialize screen. Panel RAM holds random data at power up, so every page starts dirty and
+ *          the first flush (oled_clear) writes the whole screen.
  * 
  */
 void oled_init()
 {
+    for(uint8_t i=0; i<OLED_PAGE_SIZE; i++)
+    {
+        dirty_start[i] = 0;
+        dirty_end[i] = OLED_ROW_SIZE-1;
+    }
+
     oled_write_command(0xa8);
 	oled_write_command(0x3f);
 	oled_write_command(0xd3);
@@ -126,13 +151,32 @@ void oled_init()
 	oled_write_command(0xaf);
 }
 
-/*  \brief  Refresh screen.
+/*  \brief  Refresh whole screen.
  * 
  */
 void oled_refresh()
 {
-    for(uint16_t i=0; i<NUM_PAGES; i++)
-        write_page_oled(i, matrix[i]);
+    for(uint8_t i=0; i<OLED_PAGE_SIZE; i++)
+        oled_mark_dirty(i, 0, OLED_ROW_SIZE-1);
+
+    oled_flush();
+}
+
+/*  \brief  Send only changed columns of each page to screen.
+ * 
+ */
+void oled_flush()
+{
+    for(uint8_t i=0; i<OLED_PAGE_SIZE; i++)
+    {
+        if(dirty_start[i] > dirty_end[i])
+            continue;
+
+        oled_write_span(i, dirty_start[i], &matrix[i][dirty_start[i]], dirty_end[i]-dirty_start[i]+1);
+
+        dirty_start[i] = OLED_ROW_SIZE;
+        dirty_end[i] = 0;
+    }
 }
 
 /*  \brief  Set screen constrast.
@@ -171,8 +215,8 @@ void oled_set_display_on(bool on)
 void oled_set_horizontal_scroll(scroll_dir_t dir, oled_page_t start, oled_page_t end,
                                     frame_rate_t frame_rate)
 {
-    uint8_t buffer[7] = {dir, 0x00, start, freq, end, 0x00, 0xFF};
-	multicommand_OLED(buffer, 7);
+    uint8_t buffer[7] = {dir, 0x00, start, frame_rate, end, 0x00, 0xFF};
+	oled_write_l_command(buffer, 7);
 }
 
 /*  \brief  Set screen constrast.
@@ -188,7 +232,7 @@ void oled_set_start_scroll(bool start)
        oled_write_command(OLED_STOP_SCROLL); 
 }
 
-/*  \brief  Draw pixel on screen.
+/*  \brief  Draw pixel on screen (shown on next oled_flush).
  *
  *  \param  x       X coordinate of pixel.
  *  \param  y       Y coordinate of pixel.
@@ -196,11 +240,11 @@ void oled_set_start_scroll(bool start)
  */
 void oled_set_pixel(uint8_t x, uint8_t y)
 {
-    matrix[y/NUM_PAGES][x] |= 0x01 << (y%8);
-    oled_write_page(y/NUM_PAGES, matrix[y/NUM_PAGES], PAGE_SIZE);
+    matrix[y/8][x] |= 0x01 << (y%8);
+    oled_mark_dirty(y/8, x, x);
 }
 
-/*  \brief  Clear pixel on screen.
+/*  \brief  Clear pixel on screen (shown on next oled_flush).
  *
  *  \param  x       X coordinate of pixel.
  *  \param  y       Y coordinate of pixel.
@@ -208,8 +252,8 @@ void oled_set_pixel(uint8_t x, uint8_t y)
  */
 void oled_reset_pixel(uint8_t x, uint8_t y)
 {
-    matrix[y/NUM_PAGES][x] = matrix[y/NUM_PAGES][x] ^(matrix[y/NUM_PAGES][x] & (0x01<<y%8));
-    oled_write_page(y/NUM_PAGES, matrix[y/NUM_PAGES]);
+    matrix[y/8][x] &= ~(0x01 << (y%8));
+    oled_mark_dirty(y/8, x, x);
 }
 
 /*  \brief  Clear screen.
@@ -217,13 +261,19 @@ void oled_reset_pixel(uint8_t x, uint8_t y)
  */
 void oled_clear()
 {
-    for(uint8_t i=0; i<NUM_PAGES; i++)
+    for(uint8_t i=0; i<OLED_PAGE_SIZE; i++)
     {
-        for(uint8_t j=0; j<PAGE_SIZE;j++)
-          screen[i][j] = 0x00;
+        for(uint8_t j=0; j<OLED_ROW_SIZE; j++)
+        {
+            if(matrix[i][j])
+            {
+                matrix[i][j] = 0x00;
+                oled_mark_dirty(i, j, j);
+            }
+        }
     }
 
-    refresh_oled();
+    oled_flush();
 }
 
 /*  \brief  Draw string on screen.
@@ -236,18 +286,19 @@ void oled_clear()
 void oled_draw_string(char *str, uint8_t x, uint8_t y)
 {
     uint8_t i=0;
+    uint8_t x0 = x;
 
-    while(str[i] != '\0')
+    while(str[i] != '\0' && x+6 <= OLED_ROW_SIZE)
 	{
 
 		for(uint8_t k=0; k<6; k++)
 		{
 			for(uint8_t j=0; j<8; j++)
 			{
-                if((font_8_table[str[i] -32][k]>>j & 0x01))
-                    matrix[(y+j)/NUM_PAGES][x+k] |= 0x01 << ((y+j)%8);
+                if((font_8_table[(str[i] -32)*6 + k]>>j & 0x01))
+                    matrix[(y+j)/8][x+k] |= 0x01 << ((y+j)%8);
                 else
-                    matrix[(y+j)/NUM_PAGES][x+k] = matrix[(y+j)/NUM_PAGES][x+k]^(matrix[(y+j)/NUM_PAGES][x+k] & (0x01<<(y+j)%8));
+                    matrix[(y+j)/8][x+k] &= ~(0x01 << ((y+j)%8));
 			}
 
 		}
@@ -256,7 +307,14 @@ void oled_draw_string(char *str, uint8_t x, uint8_t y)
 		i++;
 	}
 
-    refresh_oled();
+    if(x > x0)
+    {
+        oled_mark_dirty(y/8, x0, x-1);
+        if(y%8)
+            oled_mark_dirty(y/8+1, x0, x-1);
+    }
+
+    oled_flush();
 }
 
 /*  \brief  Draw pixel on screen.
@@ -268,29 +326,120 @@ void oled_draw_string(char *str, uint8_t x, uint8_t y)
  *  \param size         Size of pointer bitmap.
  *  
  */
-void oled_draw_bitmap(const uint8_t bitmap, uint8_t x, uint8_t y, uint8_t width, uint16_t size)
+void oled_draw_bitmap(const uint8_t *bitmap, uint8_t x, uint8_t y, uint8_t width, uint16_t size)
 {
-    uint8_t j=0;
+    uint8_t j=y/8;
     uint16_t k=0;
-    while(k<size)
+    while(k<size && j<OLED_PAGE_SIZE)
     {
-        for(uint8_t i=0; i<=width; i++)
+        for(uint8_t i=0; i<=width && k<size; i++)
         {
             matrix[j][x+i]=reverse(bitmap[k]);
             k++;
         }
+        oled_mark_dirty(j, x, x+width);
         j++;
     }
 
-    refresh_oled(matrix);
+    oled_flush();
 }
 
+/*  \brief  Draw filled rectangle on screen.
+ *
+ *  \param  x0          X coordinate of first corner.
+ *  \param  y0          Y coordinate of first corner.
+ *  \param  x1          X coordinate of second corner (exclusive).
+ *  \param  y1          Y coordinate of second corner (exclusive).
+ *  
+ */
 void oled_draw_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
 {
-    for(uint8_t i=x0; iz x1; i++)
+    if(x1 <= x0 || y1 <= y0)
+        return;
+
+    for(uint8_t i=x0; i<x1; i++)
+    {
+        for(uint8_t j=y0; j<y1; j++)
+            matrix[j/8][i] |= 0x01 << (j%8);
+    }
+
+    for(uint8_t j=y0/8; j<=(y1-1)/8; j++)
+        oled_mark_dirty(j, x0, x1-1);
+
+    oled_flush();
+}
+
+/*  \brief  Draw line on screen with Bresenham algorithm (shown on next oled_flush).
+ *
+ *  \param  x0          X coordinate of start point.
+ *  \param  y0          Y coordinate of start point.
+ *  \param  x1          X coordinate of end point.
+ *  \param  y1          Y coordinate of end point.
+ *  
+ */
+void oled_draw_line(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+    int16_t dx = x1>x0 ? x1-x0 : x0-x1;
+    int16_t dy = y1>y0 ? y0-y1 : y1-y0;
+    int8_t sx = x0<x1 ? 1 : -1;
+    int8_t sy = y0<y1 ? 1 : -1;
+    int16_t err = dx+dy, e2;
+    uint8_t xa = x0 < x1 ? x0 : x1, xb = x0 < x1 ? x1 : x0;
+    uint8_t ya = y0 < y1 ? y0 : y1, yb = y0 < y1 ? y1 : y0;
+
+    if(yb >= OLED_HEIGHT_SIZE)
+        yb = OLED_HEIGHT_SIZE-1;
+
+    while(1)
+    {
+        if(x0 < OLED_WIDTH_SIZE && y0 < OLED_HEIGHT_SIZE)
+            matrix[y0/8][x0] |= 0x01 << (y0%8);
+
+        if(x0 == x1 && y0 == y1)
+            break;
+
+        e2 = 2*err;
+        if(e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if(e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+
+    for(uint8_t j=ya/8; j<=yb/8; j++)
+        oled_mark_dirty(j, xa, xb);
+}
+
+/*  \brief  Set or clear rectangle on screen (shown on next oled_flush).
+ *
+ *  \param  x0          X coordinate of first corner.
+ *  \param  y0          Y coordinate of first corner.
+ *  \param  x1          X coordinate of second corner (exclusive).
+ *  \param  y1          Y coordinate of second corner (exclusive).
+ *  \param  set         True to set pixels or false to clear them.
+ *  
+ */
+void oled_fill_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, bool set)
+{
+    if(x1 <= x0 || y1 <= y0)
+        return;
+
+    for(uint8_t i=x0; i<x1; i++)
     {
         for(uint8_t j=y0; j<y1; j++)
-            matrix[j/NUM_PAGES][i] |= 0x01 << (j%8);
+        {
+            if(set)
+                matrix[j/8][i] |= 0x01 << (j%8);
+            else
+                matrix[j/8][i] &= ~(0x01 << (j%8));
+        }
     }
-    refresh_oled();
-}
\ No newline at end of file
+
+    for(uint8_t j=y0/8; j<=(y1-1)/8; j++)
+        oled_mark_dirty(j, x0, x1-1);
+}
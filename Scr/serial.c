@@ -1,71 +1,82 @@
 /*INCLUDES********************************************************************************************/
 #include "string.h"
 
+#include "hardware/irq.h"
+
 #include "serial.h"
+#include "ring.h"
+#include "frame.h"
+#include "hal.h"
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint8_t rx_ring_buffer[UART_RX_RING_SIZE];
+static ring_t rx_ring;
+static TaskHandle_t serial_task_handle = NULL;
 
 /*PROTOTYPES*****************************************************************************************/
 static void serial_receive_task(void *arg); 
+static void serial_rx_irq_handler();
 
 /*FUNCTIONS*******************************************************************************************/
+static void serial_rx_irq_handler()
+{
+    BaseType_t woken = pdFALSE;
+
+    while(hal_uart_readable())
+        ring_put(&rx_ring, hal_uart_getc());
+
+    vTaskNotifyGiveFromISR(serial_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 static void serial_receive_task(void *arg)
 {
-    uint8_t index;
-    TickType_t timeout;
     uint8_t status;
-    char buffer_rx[MAX_SIZE_BUFFER_RX];
-    instruction_t qt_instruct;
+    uint8_t data;
+    frame_rx_t frame = {0};
+    command_t command;
+
+    serial_task_handle = xTaskGetCurrentTaskHandle();
+    uart_set_irq_enables(UART_PORT, true, false);
+    irq_set_enabled(UART0_IRQ, true);
 
     while(1)
     {
-        if(uart_is_readable(UART_PORT))
+        if(ulTaskNotifyTake(pdTRUE, frame.index ? UART_MAX_TIMEOUT : portMAX_DELAY) == 0)
         {
-            index = 0;
-            memset(buffer_rx, '\0', MAX_SIZE_BUFFER_RX);
-            timeout = xTaskGetTickCount() + UART_MAX_TIMEOUT;
+            frame.index = 0;
+            status = TIME_OUT;
+            xQueueSend(status_queue, &status, portMAX_DELAY);
+            continue;
+        }
 
-            while(1)
+        while(ring_get(&rx_ring, &data))
+        {
+            switch(frame_rx_feed(&frame, data))
             {
-                if(uart_is_readable(UART_PORT))
-                {
-                    buffer_rx[index] = uart_getc(UART_PORT);
-                    index++;
-                }
-
-                if(buffer_rx[index-1] == '.')
-                {
+                case FRAME_RX_COMPLETE:
                     status = RECEIVE;
+                    xQueueSend(status_queue, &status, portMAX_DELAY);
+
+                    if(command_parse(&command, frame.buffer))
+                        xQueueSend(app_instruction_queue, &command, portMAX_DELAY);
+
+                    else
+                    {
+                        status = ERROR_RX;
+                        xQueueSend(status_queue, &status, portMAX_DELAY);
+                    }
                     break;
-                }
 
-                if(index>=MAX_SIZE_BUFFER_RX)
-                {
+                case FRAME_RX_OVERFLOW:
                     status = OVERFLOW;
+                    xQueueSend(status_queue, &status, portMAX_DELAY);
                     break;
-                }
 
-                if(xTaskGetTickCount()>timeout)
-                {
-                    status = TIME_OUT;
+                default:
                     break;
-                }
-            } 
-        
-            xQueueSend(status_queue, &status, portMAX_DELAY);
-
-            if(status == RECEIVE)
-            {
-                if(read_instruct(&qt_instruct, buffer_rx))
-                    xQueueSend(app_instruction_queue, &qt_instruct, portMAX_DELAY);
-
-                else
-                {
-                    status = ERROR_RX;
-                    xQueueSend(status_queue, &status, portMAX_DELAY);
-                }
             }
-            
         }
-        vTaskDelay(1);
     }
 }
 
@@ -77,6 +88,9 @@ void serial_init()
     uart_set_hw_flow(UART_PORT, false, false);
     uart_set_format(UART_PORT, 8, 1, UART_PARITY_NONE);
     uart_set_fifo_enabled(UART_PORT, true);
+
+    ring_init(&rx_ring, rx_ring_buffer, UART_RX_RING_SIZE);
+    irq_set_exclusive_handler(UART0_IRQ, serial_rx_irq_handler);
 }
 
 void serial_transmit(char *str)
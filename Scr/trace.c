@@ -0,0 +1,98 @@
+/*INCLUDES********************************************************************************************/
+#include "string.h"
+
+#include "trace.h"
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    uint16_t duration[TRACE_RING_SIZE];
+    volatile uint32_t head;
+}trace_ring_t;
+
+/*GLOBAL VARIABLES************************************************************************************/
+static trace_ring_t rings[TRACE_EVENTS];
+static const uint16_t bucket_us[TRACE_EVENTS] = {
+    TRACE_BUCKET_US, TRACE_BUCKET_US, TRACE_BUCKET_US, TRACE_BUCKET_US,
+    TRACE_BUCKET_US, TRACE_BUCKET_US, TRACE_BUCKET_US, TRACE_SETTLE_BUCKET_US
+};
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Store duration of one event, a store and an increment so it fits any ISR.
+ *          Each event has one producer (one ISR or core1), so no locking is needed.
+ *
+ *  \param  event       Event id.
+ *  \param  us          Duration in us, saturated to 65535.
+ *
+ */
+void trace_record(trace_event_t event, uint32_t us)
+{
+    trace_ring_t *ring = &rings[event];
+    uint32_t head = ring->head;
+
+    ring->duration[head & (TRACE_RING_SIZE-1)] = us > 0xFFFF ? 0xFFFF : us;
+    ring->head = head+1;
+}
+
+/*  \brief  Statistics over the last TRACE_RING_SIZE durations of an event.
+ *          Runs on a task, an event recorded meanwhile may replace one sample.
+ *
+ *  \param  event       Event id.
+ *  \param  stats       Pointer to output, count is the total number of events recorded.
+ *
+ *  \return false if event was never recorded.
+ *
+ */
+bool trace_get_stats(trace_event_t event, trace_stats_t *stats)
+{
+    static uint16_t histogram[TRACE_BUCKETS];
+    trace_ring_t *ring = &rings[event];
+    uint32_t head = ring->head;
+    uint32_t n = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+    uint32_t sum = 0, rank, acc = 0, bucket;
+    uint16_t value;
+
+    memset(stats, 0, sizeof(trace_stats_t));
+    stats->count = head;
+    if(n == 0)
+        return false;
+
+    memset(histogram, 0, sizeof(histogram));
+    stats->min = 0xFFFF;
+
+    for(uint32_t i=0; i<n; i++)
+    {
+        value = ring->duration[i];
+        sum += value;
+        if(value < stats->min)
+            stats->min = value;
+        if(value > stats->max)
+            stats->max = value;
+
+        bucket = value/bucket_us[event];
+        histogram[bucket < TRACE_BUCKETS ? bucket : TRACE_BUCKETS-1]++;
+    }
+
+    stats->avg = sum/n;
+
+    //Upper edge of the bucket holding the 99th percentile, max if it is in the last bucket
+    rank = (n*99 + 99)/100;
+    for(bucket=0; bucket<TRACE_BUCKETS; bucket++)
+    {
+        acc += histogram[bucket];
+        if(acc >= rank)
+            break;
+    }
+
+    stats->p99 = bucket < TRACE_BUCKETS-1 ? (bucket+1)*bucket_us[event] : stats->max;
+    if(stats->p99 > stats->max)
+        stats->p99 = stats->max;
+
+    return true;
+}
+
+void trace_reset()
+{
+    for(uint8_t i=0; i<TRACE_EVENTS; i++)
+        rings[i].head = 0;
+}
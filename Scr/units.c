@@ -0,0 +1,36 @@
+/*INCLUDES********************************************************************************************/
+#include "units.h"
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Convert interleaved ADC codes in place to engineering units:
+ *          value = ((code*scale) >> UNITS_SCALE_SHIFT) + offset, saturated to 0..UNITS_MAX_VALUE.
+ *          Units follow the calibration (mV for voltages, uA or nA for currents).
+ *
+ *  \param  buffer      Pointer to samples, channels interleaved.
+ *  \param  len         Number of samples (all channels).
+ *  \param  channels    Number of interleaved channels (up to UNITS_CHANNELS).
+ *  \param  cal         Pointer to scale and offset of each channel.
+ *
+ */
+void units_convert(uint16_t *buffer, uint32_t len, uint8_t channels, const units_cal_t *cal)
+{
+    int64_t value;
+    uint8_t c = 0;
+
+    for(uint32_t i=0; i<len; i++)
+    {
+        value = ((int64_t)(buffer[i] & 0x0FFF)*cal[c].scale + (1 << (UNITS_SCALE_SHIFT-1))) >> UNITS_SCALE_SHIFT;
+        value += cal[c].offset;
+
+        if(value < 0)
+            value = 0;
+        else if(value > UNITS_MAX_VALUE)
+            value = UNITS_MAX_VALUE;
+
+        buffer[i] = value;
+
+        if(++c == channels)
+            c = 0;
+    }
+}
@@ -13,6 +13,7 @@
 #include "stdarg.h"
 
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 
 #include "hardware/adc.h"
 #include "hardware/spi.h"
@@ -21,6 +22,8 @@
 #include "hardware/irq.h"
 #include "hardware/timer.h"
 #include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
 
 #include "FreeRTOS.h"
 #include "FreeRTOSConfig.h"
@@ -30,6 +33,15 @@
 
 #include "Inc/screen.h"
 #include "Inc/global_variables.h"
+#include "Inc/frame.h"
+#include "Inc/reduce.h"
+#include "Inc/ring.h"
+#include "Inc/command.h"
+#include "Inc/ramp.h"
+#include "Inc/hal.h"
+#include "Inc/trace.h"
+#include "Inc/units.h"
+#include "Inc/calib.h"
 
 /*DEFINES***********************************************************************************************************/
 //SYSTEM------------------------------------------------------------------------------------------------------------
@@ -56,6 +68,10 @@
 #define MAX_SIZE_BUFFER_RX          50
 #define MAX_SIZE_BUFFER_TX          25
 #define UART_MAX_TIMEOUT            10
+#define UART_MAX_BAUDRATE           1000000
+#define UART_RX_RING_SIZE           256
+#define TRACE_GROUP_MAX_SIZE        36      //"<count>,<min>,<avg>,<max>,<p99>;": 10 digits, 4x5 digits, 5 separators
+#define TRACE_REPLY_SIZE            (16+TRACE_EVENTS*TRACE_GROUP_MAX_SIZE)
 
 //I2C----------------------------------------------------------------------------------------------------------------
 #define I2C_PORT                  i2c0
@@ -78,67 +94,230 @@
 #define ADC_PIN_CH_1               26
 #define ADC_PIN_CH_2               27
 #define ADC_PIN_CH_3               28
-#define ADC_CLK_DIV                0
-#define ADC_SIZE_BUFFER            19100
+#define ADC_CLK_DIV                0       //Default, 'k' command changes it
+#define ADC_CLK_DIV_MIN            96      //Non zero dividers below one conversion time are invalid
+#define ADC_CLK_MHZ                48
+#define ADC_SAMPLE_CYCLES(div)     ((div) ? (div)+1 : ADC_CLK_DIV_MIN)     //ADC clocks per sample
+#define ADC_SIZE_BUFFER            19100   //Capture pool per buffer, default capture length
+#define ADC_CHANNELS               2
+#define ADC_BURST_SIZE             32      //Synchronized mode: samples (all channels) per DAC step
+#define ADC_SETTLE_US              20      //Synchronized mode: DAC step to burst delay
+#define ADC_CAPTURE_BUFFERS        2
+#define ADC_BITS_FULL              12
+#define ADC_BITS_FAST              8       //FIFO byte shift, one byte per sample: twice the depth
+#define AVG_SIZE_BUFFER            (DAC_STEPS_MAX*ADC_BURST_SIZE)     //One accumulator per burst sample
+#define AVG_MAX_REPEATS            1023    //Fits ACQ_REQ_REPEAT_MASK, 4095*1023 fits 32 bits
+#define AVG_SETTLE_US              1000    //DUT recovery from the top of the ramp between passes
+#define CAPTURE_WAIT_TICKS         5000
+#define LIVE_MAX_POINTS            512     //Continuous mode: reduced points per streamed curve
+#define CURVE_MAX_POINTS           (ADC_SIZE_BUFFER/ADC_CHANNELS)     //Reduced points per channel, 0: raw
+#define CURVE_MAX_PERCENT          100     //VCE amplitude argument, percent of full scale
 
 //DAC----------------------------------------------------------------------------------------------------------------
-#define PERIOD_US                40000
+#define PERIOD_US                40000   //Default sweep, 'k' command changes it
 #define ELAPCED_US               200
-#define DAC_SIZE_BUFFER          (PERIOD_US/ELAPCED_US) +1
+#define DAC_STEPS_DEFAULT        ((PERIOD_US/ELAPCED_US) +1)     //Default step count
+#define DAC_STEPS_MAX            512     //Step pool, a burst per step still fits ADC_SIZE_BUFFER
+#define DAC_STREAM_DMA           1       //1: ramp streamed to DAC by DMA, 0: stepped by core1 polling
+#define DAC_STREAM_SIZE          (DAC_STEPS_MAX*2)
+#define DAC_STEP_MIN_US          25      //Fast write (2 bytes) at I2C_BAUDRATE plus margin
+#define DAC_STEP_MAX_US          1000    //DMA pacing timer denominator is 16-bit at 130 MHz
+#define DAC_VBE_AMPLITUDE        1241    //0.3030 of full scale
+#define ADAPT_COARSE_STEPS       17      //Adaptive sweep: uniform pass that locates the knee
+#define ADAPT_IC_CHANNEL         1       //Adaptive sweep: channel whose slope drives the step density
+#define PULSE_MAX_US             10000
+
+//Synchronized and averaged sweeps keep one burst per step in the capture buffer
+#if DAC_STEPS_MAX*ADC_BURST_SIZE > ADC_SIZE_BUFFER
+#error "DAC_STEPS_MAX bursts do not fit ADC_SIZE_BUFFER"
+#endif
 
 //DIG POT-----------------------------------------------------------------------------------------------------------
 #define POT_SIZE_BUFFER      5
 
+//CORE1 ACQUISITION--------------------------------------------------------------------------------------------------
+#define ACQ_REQ_DIR_MASK           0x000000FF
+#define ACQ_REQ_BUFFER_LSB         8
+#define ACQ_REQ_POT_BIT            0x00010000      //VCE sweep: set pot to resistor_value
+#define ACQ_REQ_SYNC_BIT           0x00020000      //One ADC burst per DAC step
+#define ACQ_REQ_ADAPT_BIT          0x00040000      //Coarse pass then adapt_steps dense around the knee
+#define ACQ_REQ_PARK_BIT           0x00080000      //Spin in RAM while core0 writes flash
+#define ACQ_REQ_BYTE_BIT           0x00100000      //8-bit samples, DMA in bytes
+#define ACQ_REQ_REPEAT_LSB         21              //Synchronized passes averaged on core1, 0 or 1: single
+#define ACQ_REQ_REPEAT_MASK        0x3FF
+#define ACQ_DONE_BIT               0x80000000
+
+//CALIBRATION--------------------------------------------------------------------------------------------------------
+#define CALIB_FLASH_OFFSET         (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)     //Last sector
+#define CALIB_FLASH_SIZE           ((sizeof(calib_table_t)+FLASH_PAGE_SIZE-1)/FLASH_PAGE_SIZE*FLASH_PAGE_SIZE)
+#define CALIB_SETTLE_US            200
+
+//GUI----------------------------------------------------------------------------------------------------------------
+#define GUI_PERIOD_MS              100
+#define GUI_SEGMENTS_PER_TICK      16
+#define GUI_BAR_HEIGHT             4
+#define GUI_PLOT_Y                 8
+#define GUI_PREVIEW_POINTS         OLED_WIDTH_SIZE
+#define GUI_X_CHANNEL              0       //VCE
+#define GUI_Y_CHANNEL              1       //IC
+
 //SYSTEM-------------------------------------------------------------------------------------------------------------
 #define LED_STATUS                25
 #define RELE_PIN                  15
 #define GAIN_PIN                  18
 #define OPA_ENA_PIN               21
 
+//FRONT END---------------------------------------------------------------------------------------------------------
+#define FRONT_RELE_MS             10      //Relay and gain switch settle, default of 'p' command
+#define FRONT_OPA_MS              1
+#define FRONT_SETTLE_LSB          8       //Two readings this close end the settle
+#define FRONT_SETTLE_MAX_MS       20
+
 /*TYPEDEFS*********************************************************************************************************/
 typedef enum{
     vce,
     vbe
 }curve_t;
 
+typedef enum{
+    FRONT_RELE,
+    FRONT_GAIN,
+    FRONT_OPA,
+    FRONT_CONFIRM,
+    FRONT_READY
+}front_state_t;
+
 typedef struct{
-    char cmd;
-#ifndef MAX_SIZE_INSTRUCTION_ARG
-#define MAX_SIZE_INSTRUCTION_ARG    40
-#endif
-    char arg[MAX_SIZE_INSTRUCTION_ARG];
+    uint16_t rele_ms;
+    uint16_t opa_ms;
+    uint16_t settle_lsb;
+    uint16_t settle_max_ms;
+}front_config_t;
+
+typedef struct{
+    front_state_t state;
+    bool rele;
+    bool target;
+    TickType_t deadline;
+    TickType_t limit;
+    uint16_t last;
+    uint32_t start_us;
+}front_t;
 
-}instruction_t;
+typedef struct{
+    uint32_t step_us;
+    uint16_t steps;
+    uint16_t adc_clkdiv;
+    uint32_t capture_len;
+}sweep_config_t;
+
+typedef struct{
+    uint32_t width_us;          //0: DAC held for the whole step
+    uint32_t delay_us;          //Edge to burst
+    uint8_t duty;               //Percent, sets the step period
+}pulse_config_t;
+
+typedef struct{
+    uint8_t start;
+    uint16_t step;
+    uint16_t count;             //Up to 256 curves (codes 0..255)
+    uint16_t index;
+    bool active;
+}family_t;
 
 /*GLOBAL VARIABLES*************************************************************************************************/
 //SYSTEM-----------------------------------------------------------------------------------------------------------
 curve_t type;
-uint8_t n_samples;
+uint16_t n_samples;
+bool sync_mode;
+bool live_mode;                 //Continuous sweeps until 't'
+bool live_next;                 //Continuous mode: last sweep ended, start the next one
+reduce_mode_t reduce_mode;
+sweep_config_t sweep_config = {ELAPCED_US, DAC_STEPS_DEFAULT, ADC_CLK_DIV, ADC_SIZE_BUFFER};
+pulse_config_t pulse_config;
 
 //UART-------------------------------------------------------------------------------------------------------------
 //char buffer_rx[MAX_SIZE_BUFFER_RX];
 //char buffer_tx[MAX_SIZE_BUFFER_TX];
 //int uart_irq;
 
+//UART RX----------------------------------------------------------------------------------------------------------
+uint8_t rx_ring_buffer[UART_RX_RING_SIZE];
+ring_t rx_ring;
+TaskHandle_t serial_task_handle = NULL;
+
+//UART TX DMA------------------------------------------------------------------------------------------------------
+uint8_t tx_buffer[FRAME_ADC_MAX_SIZE(ADC_SIZE_BUFFER)];
+uint uart_dma_ch;
+dma_channel_config uart_dma_config;
+
 //ADC--------------------------------------------------------------------------------------------------------------
-uint16_t adc[ADC_SIZE_BUFFER];
+uint16_t adc[ADC_CAPTURE_BUFFERS][ADC_SIZE_BUFFER];
+curve_t capture_type[ADC_CAPTURE_BUFFERS];
+uint8_t capture_code[ADC_CAPTURE_BUFFERS];
+int16_t capture_curve[ADC_CAPTURE_BUFFERS];
+uint16_t capture_family[ADC_CAPTURE_BUFFERS];
+uint16_t capture_points[ADC_CAPTURE_BUFFERS];
+reduce_mode_t capture_mode[ADC_CAPTURE_BUFFERS];
+uint32_t capture_len[ADC_CAPTURE_BUFFERS];
+uint8_t capture_channel[ADC_CAPTURE_BUFFERS];
+uint8_t capture_bits[ADC_CAPTURE_BUFFERS];
+uint8_t adc_bits = ADC_BITS_FULL;
+uint32_t avg_acc[AVG_SIZE_BUFFER];
+uint16_t avg_repeats = 1;
+frame_format_t upload_format;
+bool units_mode;
+//Q16.16 scale and offset per gain (GAIN_PIN) and channel, default is mV at the ADC pin
+units_cal_t units_cal[UNITS_GAINS][UNITS_CHANNELS] = {
+    {{(3300 << UNITS_SCALE_SHIFT)/4095, 0}, {(3300 << UNITS_SCALE_SHIFT)/4095, 0}},
+    {{(3300 << UNITS_SCALE_SHIFT)/4095, 0}, {(3300 << UNITS_SCALE_SHIFT)/4095, 0}}
+};
+uint8_t capture_next;
 //DAC--------------------------------------------------------------------------------------------------------------
-uint16_t index_dac;
-uint16_t dac_values[DAC_SIZE_BUFFER];
-float amp_ch1;
-repeating_timer_t timer;
+volatile uint16_t index_dac;
+uint16_t dac_values[DAC_STEPS_MAX];
+uint16_t dac_amplitude;
+ramp_profile_t ramp_profile;
+uint16_t ramp_stairs;
+uint16_t dac_stream[DAC_STREAM_SIZE];
+uint16_t coarse_values[ADAPT_COARSE_STEPS];
+uint16_t adapt_values[DAC_STEPS_MAX];
+uint16_t adapt_steps;
+volatile uint16_t sweep_steps = DAC_STEPS_DEFAULT;
 
 //DIG POT----------------------------------------------------------------------------------------------------------
 uint8_t resistor_value;
 
+//FAMILY----------------------------------------------------------------------------------------------------------
+family_t family;
+
+//FRONT END-------------------------------------------------------------------------------------------------------
+front_t front = {FRONT_READY, false, false, 0, 0, 0, 0};
+front_config_t front_config = {FRONT_RELE_MS, FRONT_OPA_MS, FRONT_SETTLE_LSB, FRONT_SETTLE_MAX_MS};
+uint32_t probe_request;
+bool probe_pending;
+
+//GUI-------------------------------------------------------------------------------------------------------------
+uint8_t preview_x[GUI_PREVIEW_POINTS];
+uint8_t preview_y[GUI_PREVIEW_POINTS];
+uint16_t preview_len;
+TaskHandle_t gui_task_handle = NULL;
+
+//CALIBRATION-----------------------------------------------------------------------------------------------------
+calib_table_t calib;
+volatile bool core1_parked;
+
 //DMA-------------------------------------------------------------------------------------------------------------
-uint dma_ch;
+uint dma_ch[ADC_CAPTURE_BUFFERS];
 dma_channel_config dma_config;
 
 //SEMAPHORES------------------------------------------------------------------------------------------------------
 //SemaphoreHandle_t serial_semphr = NULL;
 SemaphoreHandle_t qt_comprobe_con = NULL;
-SemaphoreHandle_t end_probe_semphr = NULL;
+SemaphoreHandle_t capture_free_semphr = NULL;
+SemaphoreHandle_t sweep_end_semphr = NULL;
+SemaphoreHandle_t i2c_bus_semphr = NULL;
+SemaphoreHandle_t uart_tx_semphr = NULL;
 
 //MUTEX-----------------------------------------------------------------------------------------------------------
 SemaphoreHandle_t serial_mutex = NULL;
@@ -146,6 +325,7 @@ SemaphoreHandle_t serial_mutex = NULL;
 //QUEUE-----------------------------------------------------------------------------------------------------------
 QueueHandle_t status_queue = NULL;
 QueueHandle_t app_instruction_queue = NULL;
+QueueHandle_t capture_queue = NULL;
 
 /*PROTOTYPES*******************************************************************************************************/
 //SYSTEM-----------------------------------------------------------------------------------------------------------
@@ -154,18 +334,27 @@ void set_opa(bool ena);
 bool i2c_check_response(uint8_t dir, uint32_t timeout);
 void debug(const char *format, ...);
 
-bool start_probe();
-void enable_opa(bool ena);
-void set_rele(bool state);
+bool start_probe(TickType_t wait);
+bool start_family(command_t *command);
+uint8_t sweep_progress();
+void next_family_sweep();
+bool family_busy(const command_t *command);
+bool probe_poll();
+void front_request(bool rele);
+bool front_poll();
 
 void init_digital_outputs();
 
 //UART-------------------------------------------------------------------------------------------------------------
 void init_serial();
 void interrupt_serial();
+void uart_rx_irq_handler();
 void transmit_serial(char *message);
-bool read_instruct(instruction_t *qt_instruct, char *instruct);
-uint8_t transmit_adc_values();
+uint8_t transmit_adc_values(uint8_t buffer);
+uint8_t transmit_adc_bytes(uint8_t buffer);
+void transmit_buffer(const uint8_t *buffer, uint32_t size);
+bool set_serial_baudrate(uint32_t baudrate);
+void transmit_trace();
 
 //I2C--------------------------------------------------------------------------------------------------------------
 void init_i2c_bus();
@@ -177,22 +366,48 @@ void init_adc();
 //DAC--------------------------------------------------------------------------------------------------------------
 void init_dac();
 void set_dac_value(uint8_t dir, uint16_t value);
+uint8_t adc_first_channel();
+void set_capture_bits(uint8_t buffer, bool fast);
+void start_capture(uint8_t buffer);
+void stop_capture(uint8_t buffer);
+bool set_sweep_config(command_t *command);
+bool set_pulse_config(command_t *command);
+bool pulse_fits(const pulse_config_t *pulse, uint16_t adc_clkdiv);
 void generate_ramp();
-bool timer1Callback(repeating_timer_t *timer);
-bool timer2Callback(repeating_timer_t *timer);
+void generate_dac_stream();
+void start_dac_stream(uint8_t buffer, uint8_t dir);
 
 //DIG POT----------------------------------------------------------------------------------------------------------
 void init_dig_pot();
 void set_dig_pot(uint8_t value);
 
+//CALIBRATION------------------------------------------------------------------------------------------------------
+void load_calibration();
+bool run_calibration(uint8_t channel, uint8_t dir);
+bool save_calibration();
+void park_core1();
+
 //DMA--------------------------------------------------------------------------------------------------------------
 void init_dma();
+void dma_irq_handler();
+
+//CORE1 ACQUISITION-----------------------------------------------------------------------------------------------
+void acquisition_core1_entry();
+void run_sweep(uint32_t request);
+void run_sync_steps(uint8_t buffer, uint8_t dir, const uint16_t *values, uint16_t steps);
+void run_adaptive_sweep(uint8_t buffer, uint8_t dir);
+void run_averaged_sweep(uint8_t buffer, uint8_t dir, uint16_t repeats);
+void core1_fifo_irq_handler();
+
+//GUI-------------------------------------------------------------------------------------------------------------
+void update_preview(uint8_t buffer, uint32_t len);
 
 //TASK------------------------------------------------------------------------------------------------------------
 void system_status_task(void *arg);
 void comprobe_connection_task(void *arg);
 void serial_receive_task(void *arg);
 void app_main_task(void *arg);
+void upload_task(void *arg);
 void gui_task(void *arg);
 
 /*---------------------------------------------MAIN FUNCTIION----------------------------------------------------*/
@@ -201,6 +416,7 @@ int main()
     //SYSTEM INIT-------------------------------------------------------------------------------------------------
     stdio_init_all();
     set_sys_clock_khz(130000, true);
+    hal_init();
 
     init_digital_outputs();
 
@@ -212,24 +428,37 @@ int main()
     init_adc();
     init_dig_pot();
     init_dma();
+    load_calibration();
 
     //CREATE SEMAPHORES-------------------------------------------------------------------------------------------
     //serial_semphr = xSemaphoreCreateBinary();
     qt_comprobe_con = xSemaphoreCreateBinary();
-    end_probe_semphr = xSemaphoreCreateBinary();
+    capture_free_semphr = xSemaphoreCreateCounting(ADC_CAPTURE_BUFFERS, ADC_CAPTURE_BUFFERS);
+    sweep_end_semphr = xSemaphoreCreateBinary();
+    i2c_bus_semphr = xSemaphoreCreateBinary();
+    xSemaphoreGive(i2c_bus_semphr);
+    uart_tx_semphr = xSemaphoreCreateBinary();
 
     //CREATE MUTEX------------------------------------------------------------------------------------------------
     serial_mutex = xSemaphoreCreateMutex();
 
     //CREATE QUEUE-----------------------------------------------------------------------------------------------
     status_queue = xQueueCreate(MAX_SIZE_SYSTEM_QUEUE, sizeof(uint8_t));
-    app_instruction_queue = xQueueCreate(2, sizeof(instruction_t));
+    app_instruction_queue = xQueueCreate(2, sizeof(command_t));
+    capture_queue = xQueueCreate(ADC_CAPTURE_BUFFERS, sizeof(uint8_t));
+
+    //CORE1 ACQUISITION ENGINE-----------------------------------------------------------------------------------
+    multicore_launch_core1(acquisition_core1_entry);
+    irq_set_exclusive_handler(SIO_IRQ_PROC0, core1_fifo_irq_handler);
+    irq_set_enabled(SIO_IRQ_PROC0, true);
 
     //CREATE TASK------------------------------------------------------------------------------------------------
     //xTaskCreate(&system_status_task, "system status", 1024, NULL, 1, NULL);
     xTaskCreate(&comprobe_connection_task, "comprobe con", 1024, NULL, 1, NULL);
-    xTaskCreate(&serial_receive_task, "serial rx", 1024*2, NULL, 3, NULL);
+    xTaskCreate(&serial_receive_task, "serial rx", 1024*2, NULL, 3, &serial_task_handle);
     xTaskCreate(&app_main_task, "main app", 1024*2, NULL, 2, NULL);
+    xTaskCreate(&upload_task, "upload", 1024, NULL, 2, NULL);
+    xTaskCreate(&gui_task, "gui", 512, NULL, 0, &gui_task_handle);
 
     //TASK START-------------------------------------------------------------------------------------------------
     vTaskStartScheduler();
@@ -245,17 +474,13 @@ void delay_cycles(uint32_t cycles)
 
 void set_opa(bool ena)
 {
-    gpio_put(OPA_ENA_PIN, ena);
+    hal_gpio_put(OPA_ENA_PIN, ena);
     delay_cycles(100);
 }
 
 bool i2c_check_response(uint8_t dir, uint32_t timeout)
 {
-    uint8_t buffer;
-    if(i2c_read_timeout_us(I2C_PORT, dir, &buffer, 1, true, timeout)>0)
-        return true;
-    
-    return false;
+    return hal_i2c_probe(dir, timeout);
 }
 
 void debug(const char *format, ...)
@@ -351,42 +576,246 @@ void debug(const char *format, ...)
 }
 */
 
-bool start_probe()
+bool start_probe(TickType_t wait)
 {
+    uint32_t request;
+    uint8_t buffer;
+
+    //Wait for a capture buffer that is not being uploaded
+    if(xSemaphoreTake(capture_free_semphr, wait) != pdTRUE)
+        return false;
+
+    //The sweep owns i2c0 (DACs) until core1 reports its end, the OLED waits.
+    //Holding it also means core1 is idle, so the buffer tags below are not read meanwhile
+    if(xSemaphoreTake(i2c_bus_semphr, wait) != pdTRUE)
+    {
+        xSemaphoreGive(capture_free_semphr);
+        return false;
+    }
+
+    buffer = capture_next;
+    capture_next = (capture_next+1)%ADC_CAPTURE_BUFFERS;
+    capture_type[buffer] = type;
+    capture_code[buffer] = resistor_value;
+    capture_curve[buffer] = family.active ? family.index : -1;
+    capture_family[buffer] = family.count;
+    capture_points[buffer] = n_samples;
+    capture_mode[buffer] = reduce_mode;
+
     index_dac = 0;
-    enable_opa(true);
 
     if(type == vce)
     {
-        set_rele(false);
         adc_set_round_robin(0x01<<(ADC_PIN_CH_1-26)|0x01<<(ADC_PIN_CH_2-26));        
-        return add_repeating_timer_us(-ELAPCED_US, timer1Callback, NULL, &timer);
+        capture_channel[buffer] = ADC_PIN_CH_1-26;
+        request = I2C_DIR_1 | ACQ_REQ_POT_BIT;
     }
 
     else
     {
-        set_rele(true);
         adc_set_round_robin(0x01<<(ADC_PIN_CH_2-26)|0x01<<(ADC_PIN_CH_3-26));
-        set_dac_value(I2C_DIR_1, 0);
-        delay_cycles(100);
-        return add_repeating_timer_us(-ELAPCED_US, timer2Callback, NULL, &timer);
+        capture_channel[buffer] = ADC_PIN_CH_2-26;
+        request = I2C_DIR_2;
+    }
+
+    //Averaging needs every pass to sample the same instants, so it runs uniform synchronized steps
+    if(avg_repeats > 1)
+        request |= ACQ_REQ_SYNC_BIT | avg_repeats << ACQ_REQ_REPEAT_LSB;
+    else if(sync_mode || pulse_config.width_us)
+        request |= ACQ_REQ_SYNC_BIT;
+    if(type == vce && adapt_steps && avg_repeats <= 1)
+        request |= ACQ_REQ_ADAPT_BIT;
+
+    //Bursts, family frames and live reduction index 16-bit samples, fast screen only applies to free
+    //running single sweeps
+    capture_bits[buffer] = ADC_BITS_FULL;
+    if(adc_bits == ADC_BITS_FAST && !family.active && !live_mode && !(request & (ACQ_REQ_SYNC_BIT | ACQ_REQ_ADAPT_BIT)))
+    {
+        capture_bits[buffer] = ADC_BITS_FAST;
+        request |= ACQ_REQ_BYTE_BIT;
     }
 
+    //Sent to core1 by probe_poll once relay, gain and op-amp have settled
+    probe_request = request | buffer << ACQ_REQ_BUFFER_LSB;
+    probe_pending = true;
+    front_request(type == vbe);
+    probe_poll();
 
+    return true;
 }
 
-void enable_opa(bool ena)
+bool probe_poll()
 {
-    gpio_put(OPA_ENA_PIN, ena);
-    delay_cycles(1000);
+    if(!probe_pending || !front_poll())
+        return false;
+
+    //Core1 runs the sweep and answers through core1_fifo_irq_handler
+    probe_pending = false;
+    multicore_fifo_push_blocking(probe_request);
+    return true;
 }
 
-void set_rele(bool state)
+bool start_family(command_t *command)
 {
-    delay_cycles(1000000);
-    gpio_put(RELE_PIN, state);
-    delay_cycles(1000000);
-    gpio_put(GAIN_PIN, state);
+    uint32_t stop;
+
+    //<vce>-<first>-<last>-<step>[-<n_samples>[-<mode>]]
+    if(command->argc < 4)
+        return false;
+
+    //The header announces the length of the first curve for all of them, only uniform free running
+    //sweeps keep it: adaptive ones fall back to sweep_config.steps and bursts depend on the mode
+    if(adapt_steps || sync_mode || avg_repeats > 1 || pulse_config.width_us)
+        return false;
+
+    stop = command->argv[2];
+    if(command->argv[0] > CURVE_MAX_PERCENT || command->argv[1] > 255 || command->argv[3] == 0 ||
+        command->argv[3] > 255 || stop < command->argv[1] || stop > 255 ||
+        (command->argc > 4 && command->argv[4] > CURVE_MAX_POINTS) ||
+        (command->argc > 5 && command->argv[5] > REDUCE_DECIMATE))
+        return false;
+
+    //Holding the bus means core1 is idle, the ramp and the pot code are not read meanwhile
+    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+        return false;
+
+    family.start = command->argv[1];
+    family.step = command->argv[3];
+
+    dac_amplitude = command->argv[0]*RAMP_MAX_CODE/100;
+    n_samples = command->argc > 4 ? command->argv[4] : 0;
+    reduce_mode = command->argc > 5 ? command->argv[5] : REDUCE_AVERAGE;
+
+    type = vce;
+    generate_ramp();
+
+    family.count = (stop-family.start)/family.step +1;
+    family.index = 0;
+    family.active = true;
+    resistor_value = family.start;
+    xSemaphoreGive(i2c_bus_semphr);
+
+    if(!start_probe(CAPTURE_WAIT_TICKS))
+    {
+        family.active = false;
+        return false;
+    }
+
+    return true;
+}
+
+uint8_t sweep_progress()
+{
+    uint32_t step;
+
+#if DAC_STREAM_DMA
+    if(sync_mode || adapt_steps || avg_repeats > 1 || pulse_config.width_us)
+        step = index_dac;
+    else
+        step = sweep_config.steps - hal_dac_stream_remaining()/2;
+#else
+    step = index_dac;
+#endif
+
+    if(family.active)
+        return (family.index*100 + step*100/sweep_steps)/family.count;
+
+    return step*100/sweep_steps;
+}
+
+void next_family_sweep()
+{
+    if(!family.active)
+        return;
+
+    family.index++;
+    if(family.index >= family.count)
+    {
+        family.active = false;
+        return;
+    }
+
+    resistor_value = family.start + family.index*family.step;
+
+    //Only fails while both buffers wait for upload, the frame is already open so keep trying
+    while(!start_probe(CAPTURE_WAIT_TICKS));
+}
+
+bool family_busy(const command_t *command)
+{
+    //The header already announced count curves of n_samples and upload_task holds serial_mutex until the
+    //last one, anything that reconfigures or writes to serial waits for the end of the family
+    if(!family.active || command->cmd == '0')
+        return false;
+
+    debug("Error family\t\n");
+    return true;
+}
+
+void front_request(bool rele)
+{
+    //Same mode as the last sweep: only the op-amp comes back on
+    front.target = rele;
+    front.state = rele == front.rele ? FRONT_OPA : FRONT_RELE;
+    front.deadline = xTaskGetTickCount();
+    front.start_us = hal_time_us();
+}
+
+bool front_poll()
+{
+    TickType_t now = xTaskGetTickCount();
+    uint16_t value, diff;
+
+    //Each state waits for its deadline without blocking, app_main_task polls every tick meanwhile
+    while(front.state != FRONT_READY && (int32_t)(now - front.deadline) >= 0)
+    {
+        switch(front.state)
+        {
+            case FRONT_RELE:
+                hal_gpio_put(OPA_ENA_PIN, false);
+                hal_gpio_put(RELE_PIN, front.target);
+                front.deadline = now + pdMS_TO_TICKS(front_config.rele_ms);
+                front.state = FRONT_GAIN;
+                break;
+
+            case FRONT_GAIN:
+                hal_gpio_put(GAIN_PIN, front.target);
+                front.rele = front.target;
+                front.deadline = now + pdMS_TO_TICKS(front_config.rele_ms);
+                front.state = FRONT_OPA;
+                break;
+
+            case FRONT_OPA:
+                hal_gpio_put(OPA_ENA_PIN, true);
+                front.deadline = now + pdMS_TO_TICKS(front_config.opa_ms);
+                front.limit = now + pdMS_TO_TICKS(front_config.settle_max_ms);
+                front.last = 0xFFFF;
+                front.state = FRONT_CONFIRM;
+                break;
+
+            case FRONT_CONFIRM:
+                //Core1 is idle and the ADC stopped, one conversion of the first capture input
+                hal_adc_select(adc_first_channel());
+                value = hal_adc_read() & 0x0FFF;
+                diff = value > front.last ? value - front.last : front.last - value;
+                front.last = value;
+
+                if(diff <= front_config.settle_lsb || (int32_t)(now - front.limit) >= 0)
+                {
+                    adc_fifo_drain();
+                    TRACE_RECORD(TRACE_FRONT_SETTLE, hal_time_us() - front.start_us);
+                    front.state = FRONT_READY;
+                }
+                else
+                    front.deadline = now + 1;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return front.state == FRONT_READY;
 }
 
 void init_digital_outputs()
@@ -413,6 +842,24 @@ void init_serial()
     uart_set_hw_flow(UART_PORT, false, false);
     uart_set_format(UART_PORT, 8, 1, UART_PARITY_NONE);
     uart_set_fifo_enabled(UART_PORT, true);
+
+    //Enabled by serial_receive_task once its handle exists
+    ring_init(&rx_ring, rx_ring_buffer, UART_RX_RING_SIZE);
+    irq_set_exclusive_handler(UART0_IRQ, uart_rx_irq_handler);
+}
+
+void uart_rx_irq_handler()
+{
+    BaseType_t woken = pdFALSE;
+    uint32_t start = hal_time_us();
+
+    //RX level or RX timeout interrupt, a full ring drops bytes and the frame fails to parse
+    while(hal_uart_readable())
+        ring_put(&rx_ring, hal_uart_getc());
+
+    vTaskNotifyGiveFromISR(serial_task_handle, &woken);
+    TRACE_RECORD(TRACE_UART_RX_ISR, hal_time_us() - start);
+    portYIELD_FROM_ISR(woken);
 }
 
 
@@ -424,89 +871,161 @@ void transmit_serial(char *message)
 
     if(xSemaphoreTake(serial_mutex, portMAX_DELAY) == pdTRUE)
     {
-        uart_puts(UART_PORT, buffer_tx);
+        hal_uart_write((uint8_t *)buffer_tx, strlen(buffer_tx));
         xSemaphoreGive(serial_mutex);
     }
 }
 
-bool read_instruct(instruction_t *qt_instruct, char *instruct)
+uint8_t transmit_adc_values(uint8_t buffer)
 {
-    char *token;
-    int size;
+    char curve_type;
+    uint32_t size;
+    uint32_t len;
+    int16_t curve = capture_curve[buffer];
+    uint16_t count = capture_family[buffer];
 
-    if(instruct[0] != 'Q')
-        return false;
-    if(instruct[1] != 'T')
-        return false;
-    if(instruct[2] != ':')
-        return false;
+    if(capture_bits[buffer] == ADC_BITS_FAST)
+        return transmit_adc_bytes(buffer);
 
-    char aux[MAX_SIZE_BUFFER_RX];
+    //Round robin inputs are consecutive, so the interleaved channels map to calib.channel[first..]
+    calib_apply(adc[buffer], capture_len[buffer], ADC_CHANNELS, &calib.channel[capture_channel[buffer]]);
+    len = reduce_samples(adc[buffer], capture_len[buffer], ADC_CHANNELS, capture_points[buffer],
+                            capture_mode[buffer]);
+    update_preview(buffer, len);
 
-    strcpy(aux, instruct);    
+    if(curve >= 0)
+    {
+        //Multi-curve frame: serial_mutex is held from the first curve to the last. The count comes with
+        //the capture, a new family may already be running when the last curves of this one are sent
+        if(curve == 0)
+        {
+            if(xSemaphoreTake(serial_mutex, portMAX_DELAY) != pdTRUE)
+                return ERROR;
 
-    token = strtok(aux, ":");
-    token = strtok(NULL, ";");
-    size = atoi(token);
-    token = strtok(NULL, ".");
+            size = frame_build_family_header(tx_buffer, count, len);
+            transmit_buffer(tx_buffer, size);
+        }
 
-    if(size != strlen(token))
-        return false;
+        size = frame_build_family_curve(tx_buffer, capture_code[buffer], adc[buffer], len, curve == count-1);
+        transmit_buffer(tx_buffer, size);
+
+        if(curve == count-1)
+            xSemaphoreGive(serial_mutex);
+
+        return TRANSMIT;
+    }
+
+    if(capture_type[buffer] == vce)
+        curve_type = 'e';
+    else
+        curve_type = 'f';
 
     size = 0;
 
-    while(instruct[size] != ';')
-        size++;
-    
-    size++;
-    qt_instruct->cmd = instruct[size];
-    size+=2;
+    //Converted frame takes 16 bits per sample, raw captures that do not fit tx_buffer stay in codes
+    if(units_mode && FRAME_UNITS_SIZE(len) <= FRAME_PACKED_SIZE(ADC_SIZE_BUFFER))
+    {
+        //front_poll drives GAIN_PIN with the relay, high gain on VBE curves
+        units_convert(adc[buffer], len, ADC_CHANNELS, units_cal[capture_type[buffer] == vbe]);
+        size = frame_build_units(tx_buffer, adc[buffer], len, capture_type[buffer] == vce ? 'h' : 'i');
+    }
 
-    for(uint8_t i=0; i<MAX_SIZE_INSTRUCTION_ARG; i++)
+    //Compressed frame falls back to packed when the curve is too noisy to gain anything
+    else if(upload_format == FRAME_FORMAT_RICE)
+        size = frame_build_adc_rice(tx_buffer, adc[buffer], len, ADC_CHANNELS, curve_type);
+    if(size == 0)
+        size = frame_build_adc(tx_buffer, adc[buffer], len, curve_type);
+
+    if(xSemaphoreTake(serial_mutex, portMAX_DELAY) == pdTRUE)
     {
-        qt_instruct->arg[i] = instruct[size];
-        size++; 
-        if(instruct[size] == '.')
-            break;
+        transmit_buffer(tx_buffer, size);
+        xSemaphoreGive(serial_mutex);
+
+        return TRANSMIT;
     }
 
-    return true;
+    return ERROR;
 }
 
-uint8_t transmit_adc_values()
+uint8_t transmit_adc_bytes(uint8_t buffer)
 {
-    char buffer[MAX_SIZE_BUFFER_TX];
-    char curve_type;
+    uint32_t size;
+    uint32_t len = capture_len[buffer];
 
-    if(type == vce)
-        curve_type = 'e';
-    else
-        curve_type = 'f';
+    update_preview(buffer, len);
+    size = frame_build_bytes_header(tx_buffer, len, capture_type[buffer] == vce ? 's' : 't');
 
-    int size = (ADC_SIZE_BUFFER*1.5)+5;
+    //Samples are already one byte each, the capture buffer is the payload
+    if(xSemaphoreTake(serial_mutex, portMAX_DELAY) == pdTRUE)
+    {
+        transmit_buffer(tx_buffer, size);
+        transmit_buffer((const uint8_t *)adc[buffer], len);
+        transmit_buffer(frame_tail, FRAME_TAIL_SIZE);
+        xSemaphoreGive(serial_mutex);
 
-    sprintf(buffer, "RP:%d;%c,", size, curve_type);
+        return TRANSMIT;
+    }
+
+    return ERROR;
+}
+
+void transmit_buffer(const uint8_t *buffer, uint32_t size)
+{
+    //Caller holds serial_mutex, the task sleeps until the DMA IRQ
+    dma_channel_configure(uart_dma_ch, &uart_dma_config, &uart_get_hw(UART_PORT)->dr, buffer, size, true);
+    xSemaphoreTake(uart_tx_semphr, portMAX_DELAY);
+}
+
+void transmit_trace()
+{
+    char reply[TRACE_REPLY_SIZE];
+    char body[TRACE_REPLY_SIZE-16];
+    uint32_t len = 0;
+    trace_stats_t stats;
+
+    //"RP:<len>;j,<count>,<min>,<avg>,<max>,<p99>;...end", one group per trace_event_t, in us
+    len += sprintf(&body[len], "j,");
+    for(uint8_t i=0; i<TRACE_EVENTS; i++)
+    {
+        trace_get_stats(i, &stats);
+        len += snprintf(&body[len], sizeof(body)-len, "%lu,%lu,%lu,%lu,%lu;", (unsigned long)stats.count,
+                    (unsigned long)stats.min, (unsigned long)stats.avg, (unsigned long)stats.max,
+                    (unsigned long)stats.p99);
+        if(len >= sizeof(body))
+            return;
+    }
+
+    len = sprintf(reply, "RP:%lu;%send", (unsigned long)len+3, body);
 
     if(xSemaphoreTake(serial_mutex, portMAX_DELAY) == pdTRUE)
     {
-        uart_puts(UART_PORT, buffer);
+        hal_uart_write((uint8_t *)reply, len);
+        xSemaphoreGive(serial_mutex);
+    }
+}
 
-        for(uint16_t i=0; i<ADC_SIZE_BUFFER; i+=2)
-        {
-            uart_putc(UART_PORT, adc[i]);
-            uart_putc(UART_PORT, (adc[i]>>4&0xF0)|adc[i+1]>>8);
-            uart_putc(UART_PORT, adc[i+1]);
+bool set_serial_baudrate(uint32_t baudrate)
+{
+    char message[MAX_SIZE_BUFFER_TX];
 
-        }
+    if(baudrate < UART_BAUDRATE || baudrate > UART_MAX_BAUDRATE)
+    {
+        transmit_serial("d,0");
+        return false;
+    }
 
-        uart_puts(UART_PORT, "end");
+    //Acknowledge at the old rate, the host switches after receiving it
+    sprintf(message, "d,%lu", (unsigned long)baudrate);
+    transmit_serial(message);
 
+    if(xSemaphoreTake(serial_mutex, portMAX_DELAY) == pdTRUE)
+    {
+        uart_tx_wait_blocking(UART_PORT);
+        uart_set_baudrate(UART_PORT, baudrate);
         xSemaphoreGive(serial_mutex);
-
-        return TRANSMIT;
     }
 
-    return ERROR;
+    return true;
 }
 
 //I2C--------------------------------------------------------------------------------------------------------------
@@ -538,47 +1057,179 @@ void init_adc()
     adc_gpio_init(ADC_PIN_CH_1);
     adc_gpio_init(ADC_PIN_CH_2);
     adc_gpio_init(ADC_PIN_CH_3);
-    adc_set_clkdiv(ADC_CLK_DIV);
     adc_init();
+    adc_set_clkdiv(sweep_config.adc_clkdiv);
     adc_fifo_setup(true, true, 1, true, false);
 }
 
+uint8_t adc_first_channel()
+{
+    uint32_t mask = (adc_hw->cs & ADC_CS_RROBIN_BITS) >> ADC_CS_RROBIN_LSB;
+    uint8_t channel = 0;
+
+    while(mask && !(mask & 0x01))
+    {
+        mask >>= 1;
+        channel++;
+    }
+
+    return channel;
+}
+
+void set_capture_bits(uint8_t buffer, bool fast)
+{
+    dma_channel_config config = dma_get_channel_config(dma_ch[buffer]);
+
+    //Byte shift keeps the 8 MSBs, the error flag (bit 15) has no room left
+    channel_config_set_transfer_data_size(&config, fast ? DMA_SIZE_8 : DMA_SIZE_16);
+    dma_channel_set_config(dma_ch[buffer], &config, false);
+    adc_fifo_setup(true, true, 1, !fast, fast);
+}
+
+void start_capture(uint8_t buffer)
+{
+    //Same bytes hold twice the samples in 8-bit mode
+    uint32_t len = sweep_config.capture_len;
+
+    if(capture_bits[buffer] == ADC_BITS_FAST)
+        len *= 2;
+
+    adc_run(false);
+    adc_fifo_drain();
+    //Start on the first round robin channel so samples alternate from index 0
+    hw_write_masked(&adc_hw->cs, adc_first_channel() << ADC_CS_AINSEL_LSB, ADC_CS_AINSEL_BITS);
+    delay_cycles(50);
+    capture_len[buffer] = len;
+    dma_channel_set_write_addr(dma_ch[buffer], adc[buffer], false);
+    dma_channel_set_trans_count(dma_ch[buffer], len, true);
+    adc_run(true);
+}
+
+void stop_capture(uint8_t buffer)
+{
+    adc_run(false);
+    adc_fifo_drain();
+
+    //A capture longer than the sweep is cut here, only the written samples (whole frames) are uploaded.
+    //Synchronized bursts have all completed, their count is left as is
+    capture_len[buffer] -= dma_channel_hw_addr(dma_ch[buffer])->transfer_count;
+    capture_len[buffer] -= capture_len[buffer] % ADC_CHANNELS;
+    dma_channel_abort(dma_ch[buffer]);
+}
+
 //DAC--------------------------------------------------------------------------------------------------------------
 void init_dac()
 {
     set_dac_value(I2C_DIR_1, 0);
     set_dac_value(I2C_DIR_2, 0);
+    hal_dac_stream_init(sweep_config.step_us);
 }
 
 void set_dac_value(uint8_t dir, uint16_t value)
 {
     uint8_t buffer[2] ={value>>8, value};
-    i2c_write_blocking(I2C_PORT, dir, buffer, 2, false); 
+    hal_i2c_write(dir, buffer, 2);
 }
 
-void generate_ramp()
+bool set_sweep_config(command_t *command)
+{
+    sweep_config_t config;
+
+    //<step_us>-<steps>-<adc clkdiv>-<capture len>, checked against the static pools
+    if(command->argc < 4 || family.active)
+        return false;
+
+    config.step_us = command->argv[0];
+    config.steps = command->argv[1];
+    config.adc_clkdiv = command->argv[2];
+    config.capture_len = command->argv[3];
+
+    if(config.step_us < DAC_STEP_MIN_US || config.step_us > DAC_STEP_MAX_US || config.steps < 2 || command->argv[1] > DAC_STEPS_MAX ||
+        (command->argv[2] != 0 && command->argv[2] < ADC_CLK_DIV_MIN) || command->argv[2] > 0xFFFF ||
+        config.capture_len < ADC_CHANNELS || config.capture_len > ADC_SIZE_BUFFER ||
+        config.capture_len % ADC_CHANNELS)
+        return false;
+
+    //A capture outlasting the sweep would be cut by stop_capture, ask for what the sweep can fill
+    if((uint64_t)config.capture_len*ADC_SAMPLE_CYCLES(config.adc_clkdiv) >
+        (uint64_t)config.steps*config.step_us*ADC_CLK_MHZ)
+        return false;
+
+    //A slower ADC clock must still fit the burst in the programmed pulse
+    if(!pulse_fits(&pulse_config, config.adc_clkdiv))
+        return false;
+
+    //Holding the bus means core1 is idle, nothing reads the configuration meanwhile
+    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+        return false;
+
+    sweep_config = config;
+    adc_set_clkdiv(config.adc_clkdiv);
+    hal_dac_stream_set_step(config.step_us);
+    generate_ramp();
+
+    xSemaphoreGive(i2c_bus_semphr);
+    return true;
+}
+
+bool set_pulse_config(command_t *command)
+{
+    pulse_config_t config;
+
+    //<width_us>-<delay_us>-<duty %>, width 0 turns pulses off
+    if(command->argc < 3 || family.active)
+        return false;
+
+    config.width_us = command->argv[0];
+    config.delay_us = command->argv[1];
+    config.duty = command->argv[2];
+
+    //The off time must fit the return to zero write
+    if(config.width_us != 0 && (config.width_us > PULSE_MAX_US || command->argv[2] == 0 ||
+        command->argv[2] > 100 || config.width_us*100/config.duty - config.width_us < DAC_STEP_MIN_US ||
+        !pulse_fits(&config, sweep_config.adc_clkdiv)))
+        return false;
+
+    //Same as set_sweep_config, core1 reads it during the sweep
+    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+        return false;
+
+    pulse_config = config;
+
+    xSemaphoreGive(i2c_bus_semphr);
+    return true;
+}
+
+bool pulse_fits(const pulse_config_t *pulse, uint16_t adc_clkdiv)
 {
-    float time = 0;
+    uint32_t burst_us = (ADC_BURST_SIZE*ADC_SAMPLE_CYCLES(adc_clkdiv) + ADC_CLK_MHZ-1)/ADC_CLK_MHZ;
+
+    //The burst must end before the DAC returns to zero, a stretched pulse heats the DUT
+    return pulse->width_us == 0 || pulse->delay_us + burst_us <= pulse->width_us;
+}
 
+void generate_ramp()
+{
     if(type == vce)
     {
-        amp_ch1 = (float)amp_ch1/(float)10;
-        for(uint16_t i=0; i<DAC_SIZE_BUFFER; i++)
-        {
-            dac_values[i] = (((float)amp_ch1/(float)PERIOD_US)*time)*4095;
-            time += ELAPCED_US;
-        }
+        ramp_generate(dac_values, sweep_config.steps, dac_amplitude, ramp_profile, ramp_stairs);
+        ramp_generate(coarse_values, ADAPT_COARSE_STEPS, dac_amplitude, RAMP_LINEAR, 0);
     }
-
     else
-    {
-        for(uint16_t i=0; i<DAC_SIZE_BUFFER; i++)
-        {
-            dac_values[i] = (((float)0.3030/(float)PERIOD_US)*time)*4095;
-            time += ELAPCED_US;
-        }
+        ramp_generate(dac_values, sweep_config.steps, DAC_VBE_AMPLITUDE, ramp_profile, ramp_stairs);
 
-    }
+    generate_dac_stream();
+}
+
+void generate_dac_stream()
+{
+    ramp_dac_stream(dac_stream, dac_values, sweep_config.steps);
+}
+
+void start_dac_stream(uint8_t buffer, uint8_t dir)
+{
+    start_capture(buffer);
+    hal_dac_stream_start(dir, dac_stream, 2*sweep_config.steps);
 }
 
 //DIG POT----------------------------------------------------------------------------------------------------------
@@ -600,21 +1251,148 @@ void init_dig_pot()
 void set_dig_pot(uint8_t value)
 {
     uint8_t buffer[2]={0x11, value};
-    gpio_put(SPI_PIN_CS, 0);
-    spi_write_blocking(SPI_PORT, buffer, 2);
-    gpio_put(SPI_PIN_CS, 1);
+    hal_spi_write(buffer, 2);
+}
+
+//CALIBRATION------------------------------------------------------------------------------------------------------
+void load_calibration()
+{
+    //Flash is memory mapped, loading is one copy
+    memcpy(&calib, (const void *)(XIP_BASE + CALIB_FLASH_OFFSET), sizeof(calib_table_t));
+
+    if(!calib_check(&calib))
+        memset(&calib, 0, sizeof(calib_table_t));
+}
+
+bool run_calibration(uint8_t channel, uint8_t dir)
+{
+    uint16_t ideal[CALIB_POINTS];
+    uint32_t raw[CALIB_POINTS];
+    bool valid;
+
+    //Loopback fixture: DAC output straight to the ADC input, both referenced to 3.3 V, so the DAC
+    //code is the expected reading. MCP4725 INL is far below the RP2040 ADC one, the DAC is the reference
+    if(channel >= CALIB_CHANNELS || (dir != I2C_DIR_1 && dir != I2C_DIR_2))
+        return false;
+
+    //Holding the bus means core1 is idle
+    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+        return false;
+
+    adc_run(false);
+    adc_set_round_robin(0);
+    hal_adc_select(channel);
+
+    for(uint16_t k=0; k<CALIB_POINTS; k++)
+    {
+        ideal[k] = (uint32_t)k*CALIB_MAX_CODE/(CALIB_POINTS-1);
+        set_dac_value(dir, ideal[k]);
+        hal_delay_us(CALIB_SETTLE_US);
+
+        raw[k] = 0;
+        for(uint8_t i=0; i<CALIB_AVERAGE; i++)
+            raw[k] += hal_adc_read();
+    }
+
+    set_dac_value(dir, 0);
+    adc_fifo_drain();
+
+    valid = calib_fit(&calib.channel[channel], ideal, raw, CALIB_POINTS);
+    xSemaphoreGive(i2c_bus_semphr);
+
+    return valid;
+}
+
+bool save_calibration()
+{
+    static uint8_t page[CALIB_FLASH_SIZE];
+    uint32_t ints;
+
+    //transmit_buffer returns once its DMA has finished and callers hold serial_mutex, so holding it means
+    //no TX DMA is reading frame_tail or other const data from XIP while the flash is erased
+    if(xSemaphoreTake(serial_mutex, CAPTURE_WAIT_TICKS) != pdTRUE)
+        return false;
+
+    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+    {
+        xSemaphoreGive(serial_mutex);
+        return false;
+    }
+
+    calib.magic = CALIB_MAGIC;
+    calib.version = CALIB_VERSION;
+    calib.checksum = calib_checksum(&calib);
+    memset(page, 0xFF, CALIB_FLASH_SIZE);
+    memcpy(page, &calib, sizeof(calib_table_t));
+
+    //Core1 must not fetch from flash while it is erased
+    core1_parked = false;
+    multicore_fifo_push_blocking(ACQ_REQ_PARK_BIT);
+    while(!core1_parked)
+        tight_loop_contents();
+
+    ints = save_and_disable_interrupts();
+    flash_range_erase(CALIB_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(CALIB_FLASH_OFFSET, page, CALIB_FLASH_SIZE);
+    restore_interrupts(ints);
+
+    core1_parked = false;
+    xSemaphoreGive(i2c_bus_semphr);
+    xSemaphoreGive(serial_mutex);
+
+    return true;
+}
+
+void __not_in_flash_func(park_core1)()
+{
+    core1_parked = true;
+
+    //Runs from RAM until save_calibration clears the flag
+    while(core1_parked)
+        tight_loop_contents();
 }
 
 //DMA--------------------------------------------------------------------------------------------------------------
 void init_dma()
 {
-    dma_ch = dma_claim_unused_channel(true);
-    dma_config = dma_channel_get_default_config(dma_ch);
+    //One channel per capture buffer, armed here so a sweep start only reloads the count
+    for(uint8_t i=0; i<ADC_CAPTURE_BUFFERS; i++)
+    {
+        dma_ch[i] = dma_claim_unused_channel(true);
+        dma_config = dma_channel_get_default_config(dma_ch[i]);
+
+        channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_16);
+        channel_config_set_read_increment(&dma_config, false);
+        channel_config_set_write_increment(&dma_config, true);
+        channel_config_set_dreq(&dma_config, DREQ_ADC);
+
+        dma_channel_configure(dma_ch[i], &dma_config, adc[i], &adc_hw->fifo, ADC_SIZE_BUFFER, false);
+    }
+
+    uart_dma_ch = dma_claim_unused_channel(true);
+    uart_dma_config = dma_channel_get_default_config(uart_dma_ch);
+
+    channel_config_set_transfer_data_size(&uart_dma_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&uart_dma_config, true);
+    channel_config_set_write_increment(&uart_dma_config, false);
+    channel_config_set_dreq(&uart_dma_config, uart_get_dreq(UART_PORT, true));
+
+    dma_channel_set_irq0_enabled(uart_dma_ch, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+void dma_irq_handler()
+{
+    uint32_t start = hal_time_us();
+
+    if(dma_channel_get_irq0_status(uart_dma_ch))
+    {
+        dma_channel_acknowledge_irq0(uart_dma_ch);
+        xSemaphoreGiveFromISR(uart_tx_semphr, pdFALSE);
+    }
 
-    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_16);
-    channel_config_set_read_increment(&dma_config, false);
-    channel_config_set_write_increment(&dma_config, true);
-    channel_config_set_dreq(&dma_config, DREQ_ADC);
+    TRACE_RECORD(TRACE_DMA_ISR, hal_time_us() - start);
 }
 
 //TASK------------------------------------------------------------------------------------------------------------
@@ -716,185 +1494,579 @@ void comprobe_connection_task(void *arg)
 
 void serial_receive_task(void *arg)
 {
-    uint8_t index;
-    TickType_t timeout;
     uint8_t status;
-    char buffer_rx[MAX_SIZE_BUFFER_RX];
-    instruction_t qt_instruct;
+    uint8_t data;
+    frame_rx_t frame = {0};
+    command_t command;
+
+    uart_set_irq_enables(UART_PORT, true, false);
+    irq_set_enabled(UART0_IRQ, true);
 
     while(1)
     {
-        if(uart_is_readable(UART_PORT))
+        //Sleep until the RX IRQ, a partial frame must complete within UART_MAX_TIMEOUT
+        if(ulTaskNotifyTake(pdTRUE, frame.index ? UART_MAX_TIMEOUT : portMAX_DELAY) == 0)
         {
-            index = 0;
-            memset(buffer_rx, '\0', MAX_SIZE_BUFFER_RX);
-            timeout = xTaskGetTickCount() + UART_MAX_TIMEOUT;
+            frame.index = 0;
+            status = TIME_OUT;
+            xQueueSend(status_queue, &status, portMAX_DELAY);
+            continue;
+        }
 
-            while(1)
+        while(ring_get(&rx_ring, &data))
+        {
+            switch(frame_rx_feed(&frame, data))
             {
-                if(uart_is_readable(UART_PORT))
-                {
-                    buffer_rx[index] = uart_getc(UART_PORT);
-                    index++;
-                }
-
-                if(buffer_rx[index-1] == '.')
-                {
+                case FRAME_RX_COMPLETE:
                     status = RECEIVE;
+                    xQueueSend(status_queue, &status, portMAX_DELAY);
+
+                    if(command_parse(&command, frame.buffer))
+                        xQueueSend(app_instruction_queue, &command, portMAX_DELAY);
+
+                    else
+                    {
+                        status = ERROR_RX;
+                        xQueueSend(status_queue, &status, portMAX_DELAY);
+                    }
                     break;
-                }
 
-                if(index>=MAX_SIZE_BUFFER_RX)
-                {
+                case FRAME_RX_OVERFLOW:
                     status = OVERFLOW;
+                    xQueueSend(status_queue, &status, portMAX_DELAY);
                     break;
-                }
 
-                if(xTaskGetTickCount()>timeout)
-                {
-                    status = TIME_OUT;
+                default:
                     break;
-                }
-            } 
-        
-            xQueueSend(status_queue, &status, portMAX_DELAY);
-
-            if(status == RECEIVE)
-            {
-                if(read_instruct(&qt_instruct, buffer_rx))
-                    xQueueSend(app_instruction_queue, &qt_instruct, portMAX_DELAY);
-
-                else
-                {
-                    status = ERROR_RX;
-                    xQueueSend(status_queue, &status, portMAX_DELAY);
-                }
             }
-            
         }
-        vTaskDelay(1);
     }
 }
 
 void app_main_task(void *arg)
 {
-    instruction_t qt_instruct;
-    uint8_t status;
-    char *token;
+    command_t command;
 
     while(1)
     {
-        if(xQueueReceive(app_instruction_queue, &qt_instruct, 10) == pdTRUE)
+        //Front end settling: commands wait in the queue, lower priority tasks run meanwhile
+        if(probe_pending && !probe_poll())
+        {
+            vTaskDelay(1);
+            continue;
+        }
+
+        if(xQueueReceive(app_instruction_queue, &command, 10) == pdTRUE && !family_busy(&command))
         {
-            switch (qt_instruct.cmd)
+            switch (command.cmd)
             {
                 case '0':
                     xSemaphoreGive(qt_comprobe_con);
                     break;
 
                 case 'a':
+                    //<vce>-<pot code>-<n_samples>[-<mode>]
+                    if(command.argc < 3 || command.argv[0] > CURVE_MAX_PERCENT || command.argv[1] > 255 ||
+                        command.argv[2] > CURVE_MAX_POINTS || (command.argc > 3 && command.argv[3] > REDUCE_DECIMATE))
+                        break;
+                    //Holding the bus means core1 is idle: the ramp and the pot code are not read meanwhile
+                    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+                    {
+                        debug("Error bus\t\n");
+                        break;
+                    }
                     type = vce;
-                    token = strtok(qt_instruct.arg, "-");
-                    amp_ch1 = (float)atoi(token)/(float)10;
-                    token = strtok(NULL, "-");
-                    resistor_value = atoi(token);
-                    token = strtok(NULL, "-");
-                    n_samples = atoi(token);
-                    debug("\n\tVCE:%f\nIB:%f\t\n", amp_ch1, IB_MEASSURE_VALUES[resistor_value], n_samples);
-                    generate_ramp();             
+                    dac_amplitude = command.argv[0]*RAMP_MAX_CODE/100;
+                    resistor_value = command.argv[1];
+                    n_samples = command.argv[2];
+                    reduce_mode = command.argc > 3 ? command.argv[3] : REDUCE_AVERAGE;
+                    debug("\n\tVCE:%d\nIB:%lu nA\t\n", dac_amplitude, (unsigned long)IB_MEASSURE_NA[resistor_value]);
+                    generate_ramp();
+                    xSemaphoreGive(i2c_bus_semphr);
                     break;
 
                 case 'b':
+                    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+                    {
+                        debug("Error bus\t\n");
+                        break;
+                    }
                     type = vbe;
-                    generate_ramp(); 
+                    generate_ramp();
+                    xSemaphoreGive(i2c_bus_semphr);
                     break;
 
                 case 'c':
                     debug("Starting test\t\n");
-                    if(!start_probe())
+                    if(live_mode || !start_probe(CAPTURE_WAIT_TICKS))
                         debug("Error test\t\n");
                     break;
+
+                case 'd':
+                    if(command.argc > 0)
+                        set_serial_baudrate(command.argv[0]);
+                    break;
+
+                case 'e':
+                    if(live_mode || !start_family(&command))
+                        debug("Error family\t\n");
+                    break;
+
+                case 'f':
+                    //<profile>[-<stairs>], used by the next 'a', 'b' or 'e'
+                    if(command.argc < 1 || command.argv[0] > RAMP_TRIANGLE)
+                        break;
+                    ramp_profile = command.argv[0];
+                    ramp_stairs = command.argc > 1 ? command.argv[1] : 0;
+                    break;
+
+                case 'g':
+                    //1: one ADC burst per DAC step, 0: free running capture
+                    if(command.argc > 0)
+                        sync_mode = command.argv[0];
+                    break;
+
+                case 'h':
+                    //<steps>, VCE sweeps placed around the knee after a coarse pass, 0 for uniform
+                    if(command.argc < 1 || command.argv[0] == 1 || command.argv[0] > DAC_STEPS_MAX ||
+                        command.argv[0]*ADC_BURST_SIZE > ADC_SIZE_BUFFER)
+                        break;
+                    //run_adaptive_sweep reads it on core1
+                    if(xSemaphoreTake(i2c_bus_semphr, CAPTURE_WAIT_TICKS) != pdTRUE)
+                    {
+                        debug("Error bus\t\n");
+                        break;
+                    }
+                    adapt_steps = command.argv[0];
+                    xSemaphoreGive(i2c_bus_semphr);
+                    break;
+
+                case 'i':
+                    //Upload format of single curves, 0: packed 12-bit, 1: zigzag delta + Rice
+                    if(command.argc < 1 || command.argv[0] > FRAME_FORMAT_RICE)
+                        break;
+                    upload_format = command.argv[0];
+                    break;
+
+                case 'k':
+                    if(!set_sweep_config(&command))
+                        debug("Error sweep config\t\n");
+                    break;
+
+                case 'l':
+                    //1: single curves in engineering units ('h'/'i' frames), 0: ADC codes
+                    if(command.argc > 0)
+                        units_mode = command.argv[0];
+                    break;
+
+                case 'm':
+                    //<gain>-<channel>-<Q16.16 scale>-<offset>, offset in 32-bit two's complement
+                    if(command.argc < 4 || command.argv[0] >= UNITS_GAINS || command.argv[1] >= UNITS_CHANNELS)
+                        break;
+                    units_cal[command.argv[0]][command.argv[1]].scale = (int32_t)command.argv[2];
+                    units_cal[command.argv[0]][command.argv[1]].offset = (int32_t)command.argv[3];
+                    break;
+
+                case 'n':
+                    //<ADC input>-<DAC address>, loopback fixture fitted
+                    if(command.argc < 2 || !run_calibration(command.argv[0], command.argv[1]))
+                        debug("Error calibration\t\n");
+                    break;
+
+                case 'o':
+                    //1: store calibration in flash, 0: drop it (until the next 'o,1' it is back on reset)
+                    if(command.argc < 1)
+                        break;
+                    if(command.argv[0] == 0)
+                        memset(&calib, 0, sizeof(calib_table_t));
+                    else if(!save_calibration())
+                        debug("Error calibration\t\n");
+                    break;
+
+                case 'p':
+                    //<relay ms>-<op-amp ms>-<settle lsb>-<settle max ms>
+                    if(command.argc < 4)
+                        break;
+                    front_config.rele_ms = command.argv[0];
+                    front_config.opa_ms = command.argv[1];
+                    front_config.settle_lsb = command.argv[2];
+                    front_config.settle_max_ms = command.argv[3];
+                    break;
+
+                case 'q':
+                    //Bits per sample of single free running sweeps, 12 or 8 (fast screen, 's'/'t' frames)
+                    if(command.argc < 1 || (command.argv[0] != ADC_BITS_FULL && command.argv[0] != ADC_BITS_FAST))
+                        break;
+                    adc_bits = command.argv[0];
+                    break;
+
+                case 'r':
+                    //<repeats>, sweeps averaged on the device before one upload, 1 for a single sweep
+                    if(command.argc < 1 || command.argv[0] < 1 || command.argv[0] > AVG_MAX_REPEATS)
+                        break;
+                    avg_repeats = command.argv[0];
+                    break;
+
+                case 's':
+                    //<points>[-<mode>], sweeps the last 'a'/'b' setup back to back, each reduced curve is a frame
+                    if(command.argc < 1 || command.argv[0] == 0 || command.argv[0] > LIVE_MAX_POINTS || live_mode ||
+                        (command.argc > 1 && command.argv[1] > REDUCE_DECIMATE))
+                        break;
+                    n_samples = command.argv[0];
+                    reduce_mode = command.argc > 1 ? command.argv[1] : REDUCE_AVERAGE;
+                    live_mode = true;
+                    live_next = true;
+                    break;
+
+                case 't':
+                    //Ends continuous mode, the sweep in progress is still sent
+                    live_mode = false;
+                    live_next = false;
+                    break;
+
+                case 'u':
+                    if(!set_pulse_config(&command))
+                        debug("Error pulse config\t\n");
+                    break;
+
+                case 'j':
+                    //No argument: report timing trace, 1: clear it
+                    if(command.argc > 0 && command.argv[0] == 1)
+                        trace_reset();
+                    else
+                        transmit_trace();
+                    break;
                 
                 default:
                     break;
             }
         }
 
-        if(xSemaphoreTake(end_probe_semphr, 10) == pdTRUE)
+        if(xSemaphoreTake(sweep_end_semphr, 10) == pdTRUE)
         {
-            status = transmit_adc_values();
+            next_family_sweep();
+            live_next = live_mode;
+        }
+
+        //No waiting here: while upload_task drains the other buffer the loop keeps serving 't'
+        if(live_next && !probe_pending && start_probe(0))
+            live_next = false;
+    }
+
+}
+
+void upload_task(void *arg)
+{
+    uint8_t buffer;
+    uint8_t status;
+
+    while(1)
+    {
+        //Runs while app_main_task is free to start the next sweep in the other buffer
+        if(xQueueReceive(capture_queue, &buffer, portMAX_DELAY) == pdTRUE)
+        {
+            status = transmit_adc_values(buffer);
             if(status == TRANSMIT)
                 debug("Transmit\t\n");
 
+            xSemaphoreGive(capture_free_semphr);
             xQueueSend(status_queue, &status, portMAX_DELAY);
         }
     }
-
 }
 
 void gui_task(void *arg)
 {
-    oled_init();
+    uint16_t segment = 0;
+    uint8_t progress, bar = 0xFF;
+
+    //A sweep may already own i2c0, the panel waits for its end like every flush
+    if(xSemaphoreTake(i2c_bus_semphr, portMAX_DELAY) == pdTRUE)
+    {
+        oled_init();
+        oled_clear();
+        xSemaphoreGive(i2c_bus_semphr);
+    }
+
+    while(1)
+    {
+        if(ulTaskNotifyTake(pdTRUE, 0) > 0)
+        {
+            oled_fill_rect(0, GUI_PLOT_Y, OLED_WIDTH_SIZE, OLED_HEIGHT_SIZE, false);
+            segment = 1;
+        }
+
+        //Draw a few segments per tick so a frame never holds the bus for long
+        for(uint8_t i=0; i<GUI_SEGMENTS_PER_TICK && segment>0 && segment<preview_len; i++, segment++)
+            oled_draw_line(preview_x[segment-1], preview_y[segment-1], preview_x[segment], preview_y[segment]);
+
+        progress = sweep_progress();
+        if(progress > 100)
+            progress = 100;
+        if(progress != bar)
+        {
+            bar = progress;
+            oled_fill_rect(0, 0, OLED_WIDTH_SIZE*bar/100, GUI_BAR_HEIGHT, true);
+            oled_fill_rect(OLED_WIDTH_SIZE*bar/100, 0, OLED_WIDTH_SIZE, GUI_BAR_HEIGHT, false);
+        }
+
+        if(xSemaphoreTake(i2c_bus_semphr, 0) == pdTRUE)
+        {
+            oled_flush();
+            xSemaphoreGive(i2c_bus_semphr);
+        }
+
+        vTaskDelay(GUI_PERIOD_MS);
+    }
 }
 
-//TIMER-----------------------------------------------------------------------------------------------------------
-bool timer1Callback(repeating_timer_t *timer)
+//GUI-------------------------------------------------------------------------------------------------------------
+void update_preview(uint8_t buffer, uint32_t len)
 {
-    
-    set_dac_value(I2C_DIR_1, dac_values[index_dac]);
-    if(index_dac == 0)
+    uint32_t frames = len/ADC_CHANNELS;
+    uint32_t k;
+    uint16_t x, y;
+    uint16_t points = frames < GUI_PREVIEW_POINTS ? frames : GUI_PREVIEW_POINTS;
+    const uint8_t *bytes = (const uint8_t *)adc[buffer];
+
+    if(points == 0)
+        return;
+
+    for(uint16_t i=0; i<points; i++)
     {
-        adc_run(false);
-        adc_fifo_drain();
-        hw_write_masked(&adc_hw->cs, 0 << ADC_CS_AINSEL_LSB, ADC_CS_AINSEL_BITS);
-        set_dig_pot(resistor_value);
-        delay_cycles(50);
-        dma_channel_configure(dma_ch, &dma_config, adc, &adc_hw->fifo, ADC_SIZE_BUFFER, true);
-        adc_run(true);
+        k = (i*frames/points)*ADC_CHANNELS;
+        if(capture_bits[buffer] == ADC_BITS_FAST)
+        {
+            x = bytes[k+GUI_X_CHANNEL] << 4;
+            y = bytes[k+GUI_Y_CHANNEL] << 4;
+        }
+        else
+        {
+            x = adc[buffer][k+GUI_X_CHANNEL] & 0x0FFF;
+            y = adc[buffer][k+GUI_Y_CHANNEL] & 0x0FFF;
+        }
+        preview_x[i] = (uint32_t)x*(OLED_WIDTH_SIZE-1)/4095;
+        preview_y[i] = OLED_HEIGHT_SIZE-1 - (uint32_t)y*(OLED_HEIGHT_SIZE-1-GUI_PLOT_Y)/4095;
     }
-    index_dac++;
 
-    if(index_dac>=DAC_SIZE_BUFFER)
+    preview_len = points;
+    xTaskNotifyGive(gui_task_handle);
+}
+
+//CORE1 ACQUISITION-----------------------------------------------------------------------------------------------
+void acquisition_core1_entry()
+{
+    uint32_t request;
+
+    //Core1 only runs sweeps, nothing from FreeRTOS may be called here
+    while(1)
     {
-        adc_run(false);
-        adc_fifo_drain();
+        request = multicore_fifo_pop_blocking();
+        if(request & ACQ_REQ_PARK_BIT)
+        {
+            park_core1();
+            continue;
+        }
+
+        //The buffer travels with the request, core0 picks the next one meanwhile
+        run_sweep(request);
+        multicore_fifo_push_blocking(ACQ_DONE_BIT | ((request >> ACQ_REQ_BUFFER_LSB) & 0xFF));
+    }
+}
+
+void run_sweep(uint32_t request)
+{
+    uint8_t dir = request & ACQ_REQ_DIR_MASK;
+    bool pot = request & ACQ_REQ_POT_BIT;
+    uint16_t repeats = (request >> ACQ_REQ_REPEAT_LSB) & ACQ_REQ_REPEAT_MASK;
+    uint8_t buffer = (request >> ACQ_REQ_BUFFER_LSB) & 0xFF;
+
+    index_dac = 0;
+
+    if(pot)
+        set_dig_pot(resistor_value);
+    else
         set_dac_value(I2C_DIR_1, 0);
-        set_opa(false);
-        set_dig_pot(255);
-        xSemaphoreGiveFromISR(end_probe_semphr, pdFALSE);
-        return false;
+    delay_cycles(100);
+
+    sweep_steps = sweep_config.steps;
+    set_capture_bits(buffer, request & ACQ_REQ_BYTE_BIT);
+
+    if(request & ACQ_REQ_ADAPT_BIT)
+        run_adaptive_sweep(buffer, dir);
+    else if(repeats > 1)
+        run_averaged_sweep(buffer, dir, repeats);
+    else if(request & ACQ_REQ_SYNC_BIT)
+        run_sync_steps(buffer, dir, dac_values, sweep_config.steps);
+    else
+    {
+#if DAC_STREAM_DMA
+        start_dac_stream(buffer, dir);
+        hal_dac_stream_wait();
+#else
+        //Polled steps on an otherwise idle core, no timer IRQ jitter
+        uint32_t next = hal_time_us();
+        uint32_t start;
+
+        for(index_dac=0; index_dac<sweep_config.steps; index_dac++)
+        {
+            while((int32_t)(hal_time_us() - next) < 0)
+                tight_loop_contents();
+
+            start = hal_time_us();
+            TRACE_RECORD(TRACE_STEP_LATE, start - next);
+            set_dac_value(dir, dac_values[index_dac]);
+            TRACE_RECORD(TRACE_DAC_WRITE, hal_time_us() - start);
+            if(index_dac == 0)
+                start_capture(buffer);
+
+            next += sweep_config.step_us;
+        }
+
+        while((int32_t)(hal_time_us() - next) < 0)
+            tight_loop_contents();
+#endif
     }
 
-    return true;
+    stop_capture(buffer);
+    set_dac_value(I2C_DIR_1, 0);
+    if(pot)
+        set_dig_pot(255);
+    else
+        set_dac_value(I2C_DIR_2, 0);
+    set_opa(false);
 }
 
-bool timer2Callback(repeating_timer_t *timer)
+void run_sync_steps(uint8_t buffer, uint8_t dir, const uint16_t *values, uint16_t steps)
 {
-    set_dac_value(I2C_DIR_2, dac_values[index_dac]);
-
-    if(index_dac == 0)
+    uint8_t channel = adc_first_channel();
+    uint32_t next = hal_time_us();
+    uint32_t start, edge, burst;
+    uint dma = dma_ch[buffer];
+    bool pulse = pulse_config.width_us != 0;
+    uint32_t period = pulse ? pulse_config.width_us*100/pulse_config.duty : sweep_config.step_us;
+
+    //Burst k is adc[k*ADC_BURST_SIZE .. (k+1)*ADC_BURST_SIZE-1], taken after DAC step k settled.
+    //step_us must cover the I2C write, ADC_SETTLE_US and ADC_BURST_SIZE conversions.
+    //Pulsed: the step is applied for width_us from the edge, then back to zero until the next period
+    adc_run(false);
+
+    for(index_dac=0; index_dac<steps; index_dac++)
     {
-        adc_run(false);
+        while((int32_t)(hal_time_us() - next) < 0)
+            tight_loop_contents();
+
+        start = hal_time_us();
+        TRACE_RECORD(TRACE_STEP_LATE, start - next);
+        next += period;
+
+        set_dac_value(dir, values[index_dac]);
+        edge = hal_time_us();
+        TRACE_RECORD(TRACE_DAC_WRITE, edge - start);
+        hal_delay_us(pulse ? pulse_config.delay_us : ADC_SETTLE_US);
+
         adc_fifo_drain();
-        hw_write_masked(&adc_hw->cs, 0 << ADC_CS_AINSEL_LSB, ADC_CS_AINSEL_BITS);
-        delay_cycles(50);
-        dma_channel_configure(dma_ch, &dma_config, adc, &adc_hw->fifo, ADC_SIZE_BUFFER, true);
+        hw_write_masked(&adc_hw->cs, channel << ADC_CS_AINSEL_LSB, ADC_CS_AINSEL_BITS);
+        dma_channel_set_write_addr(dma, &adc[buffer][index_dac*ADC_BURST_SIZE], false);
+        dma_channel_set_trans_count(dma, ADC_BURST_SIZE, true);
+        burst = hal_time_us();
         adc_run(true);
+        dma_channel_wait_for_finish_blocking(dma);
+        adc_run(false);
+        TRACE_RECORD(TRACE_ADC_BURST, hal_time_us() - burst);
+
+        //pulse_fits keeps the burst inside the pulse, the wait only covers the rest of the width
+        if(pulse)
+        {
+            while((int32_t)(hal_time_us() - (edge + pulse_config.width_us)) < 0)
+                tight_loop_contents();
+            set_dac_value(dir, 0);
+        }
+
+        TRACE_RECORD(TRACE_STEP_BUSY, hal_time_us() - start);
+    }
+
+    capture_len[buffer] = steps*ADC_BURST_SIZE;
+}
+
+void run_adaptive_sweep(uint8_t buffer, uint8_t dir)
+{
+    uint16_t level[ADAPT_COARSE_STEPS];
+    uint16_t *burst;
+    uint32_t sum;
+    //app_main_task only changes it while holding i2c_bus_semphr, read once so both passes agree
+    uint16_t steps = adapt_steps;
+
+    //Coarse pass, the bursts land in the capture buffer and are overwritten by the fine pass
+    sweep_steps = ADAPT_COARSE_STEPS;
+    run_sync_steps(buffer, dir, coarse_values, ADAPT_COARSE_STEPS);
+
+    for(uint16_t k=0; k<ADAPT_COARSE_STEPS; k++)
+    {
+        burst = &adc[buffer][k*ADC_BURST_SIZE];
+        sum = 0;
+        for(uint16_t i=ADAPT_IC_CHANNEL; i<ADC_BURST_SIZE; i+=ADC_CHANNELS)
+            sum += burst[i] & 0x0FFF;
+        level[k] = sum*ADC_CHANNELS/ADC_BURST_SIZE;
     }
 
-    index_dac++;
+    set_dac_value(dir, 0);
+    hal_delay_us(sweep_config.step_us);
 
-    if(index_dac>=DAC_SIZE_BUFFER)
+    //Coarse codes not increasing (amplitude too low) falls back to the uniform ramp
+    sweep_steps = steps;
+    if(ramp_adaptive(adapt_values, steps, coarse_values, level, ADAPT_COARSE_STEPS))
+        run_sync_steps(buffer, dir, adapt_values, steps);
+    else
     {
-        adc_run(false);
-        adc_fifo_drain();
-        set_dac_value(I2C_DIR_1, 0);
-        set_dac_value(I2C_DIR_2, 0);
-        set_opa(false);
-        xSemaphoreGiveFromISR(end_probe_semphr, pdFALSE);
-        return false;
+        sweep_steps = sweep_config.steps;
+        run_sync_steps(buffer, dir, dac_values, sweep_config.steps);
     }
+}
 
-    return true;
-    
-}
\ No newline at end of file
+void run_averaged_sweep(uint8_t buffer, uint8_t dir, uint16_t repeats)
+{
+    uint16_t *capture = adc[buffer];
+    uint32_t len = sweep_config.steps*ADC_BURST_SIZE;
+
+    //Sample i of every pass is taken ADC_SETTLE_US after the same DAC step, so the passes add coherently
+    memset(avg_acc, 0, len*sizeof(uint32_t));
+
+    for(uint16_t r=0; r<repeats; r++)
+    {
+        if(r > 0)
+        {
+            set_dac_value(dir, 0);
+            hal_delay_us(AVG_SETTLE_US);
+        }
+
+        run_sync_steps(buffer, dir, dac_values, sweep_config.steps);
+        for(uint32_t i=0; i<len; i++)
+            avg_acc[i] += capture[i] & 0x0FFF;
+    }
+
+    for(uint32_t i=0; i<len; i++)
+        capture[i] = (avg_acc[i] + repeats/2)/repeats;
+}
+
+void core1_fifo_irq_handler()
+{
+    uint32_t message;
+    uint8_t buffer;
+    uint32_t start = hal_time_us();
+
+    while(multicore_fifo_rvalid())
+    {
+        message = multicore_fifo_pop_blocking();
+        if(!(message & ACQ_DONE_BIT))
+            continue;
+
+        buffer = message & 0xFF;
+        xQueueSendFromISR(capture_queue, &buffer, pdFALSE);
+        xSemaphoreGiveFromISR(sweep_end_semphr, pdFALSE);
+        xSemaphoreGiveFromISR(i2c_bus_semphr, pdFALSE);
+    }
+
+    multicore_fifo_clear_irq();
+    TRACE_RECORD(TRACE_SIO_ISR, hal_time_us() - start);
+}
@@ -0,0 +1,136 @@
+/*INCLUDES********************************************************************************************/
+#include "stdio.h"
+#include "string.h"
+#include "stdbool.h"
+
+#include "rice_decode.h"
+#include "frame.h"
+
+/*TYPEDEFS********************************************************************************************/
+typedef struct{
+    const uint8_t *src;
+    uint32_t len;
+    uint32_t bit;
+}bit_reader_t;
+
+/*PROTOTYPES******************************************************************************************/
+static bool bit_read(bit_reader_t *r, uint32_t *value, uint8_t bits);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Read bits MSB first.
+ *
+ *  \param  r       Pointer to reader.
+ *  \param  value   Pointer to output, right aligned.
+ *  \param  bits    Number of bits (up to 24).
+ *
+ *  \return false past the end of input.
+ *
+ */
+static bool bit_read(bit_reader_t *r, uint32_t *value, uint8_t bits)
+{
+    *value = 0;
+
+    for(uint8_t i=0; i<bits; i++, r->bit++)
+    {
+        if(r->bit >= 8*r->len)
+            return false;
+        *value = *value << 1 | (r->src[r->bit/8] >> (7 - r->bit%8) & 1);
+    }
+
+    return true;
+}
+
+/*  \brief  Decode a zigzag delta + Rice stream.
+ *
+ *  \param  dst         Pointer to output samples.
+ *  \param  n           Number of samples (all channels).
+ *  \param  src         Pointer to stream.
+ *  \param  len         Size of stream in bytes.
+ *  \param  channels    Number of interleaved channels.
+ *
+ *  \return Number of stream bytes used, 0 if the stream is truncated or a sample leaves 12 bits.
+ *
+ */
+uint32_t rice_decode(uint16_t *dst, uint32_t n, const uint8_t *src, uint32_t len, uint8_t channels)
+{
+    bit_reader_t r = {src, len, 0};
+    uint32_t block = FRAME_RICE_BLOCK*channels;
+    uint32_t k = 0, q, u, bit;
+    int32_t sample;
+
+    if(channels == 0)
+        return 0;
+
+    for(uint32_t i=0; i<n; i++)
+    {
+        if(i%block == 0 && !bit_read(&r, &k, 4))
+            return 0;
+
+        //Unary quotient, FRAME_RICE_ESCAPE ones mean a raw 13-bit value follows
+        for(q=0; q<FRAME_RICE_ESCAPE; q++)
+        {
+            if(!bit_read(&r, &bit, 1))
+                return 0;
+            if(!bit)
+                break;
+        }
+
+        if(q == FRAME_RICE_ESCAPE)
+        {
+            if(!bit_read(&r, &u, 13))
+                return 0;
+        }
+        else
+        {
+            if(!bit_read(&r, &u, k))
+                return 0;
+            u |= q << k;
+        }
+
+        sample = (i>=channels ? dst[i-channels] : 0) + ((u & 1) ? -(int32_t)(u>>1)-1 : (int32_t)(u>>1));
+        if(sample < 0 || sample > 0x0FFF)
+            return 0;
+        dst[i] = sample;
+    }
+
+    return (r.bit+7)/8;
+}
+
+/*  \brief  Decode a whole "RP:<len>;<TYPE>,<channels><n lo><n hi><rice stream>end" frame.
+ *
+ *  \param  dst             Pointer to output samples.
+ *  \param  max             Size of output in samples.
+ *  \param  channels        Pointer to output, number of interleaved channels.
+ *  \param  curve_type      Pointer to output, lowercase curve type.
+ *  \param  frame           Pointer to frame.
+ *  \param  len             Size of frame in bytes.
+ *
+ *  \return Number of samples, 0 if the frame is malformed.
+ *
+ */
+uint32_t rice_decode_frame(uint16_t *dst, uint32_t max, uint8_t *channels, char *curve_type,
+                                const uint8_t *frame, uint32_t len)
+{
+    unsigned long body;
+    char type;
+    int header = 0;
+    uint32_t n, stream;
+
+    if(sscanf((const char *)frame, "RP:%lu;%c,%n", &body, &type, &header) != 2 || header == 0)
+        return 0;
+    if(type < 'A' || type > 'Z' || body < 8 || header+body-2 > len)
+        return 0;
+    if(memcmp(&frame[header+body-5], frame_tail, FRAME_TAIL_SIZE))
+        return 0;
+
+    *channels = frame[header];
+    *curve_type = type-'A'+'a';
+    n = frame[header+1] | frame[header+2] << 8;
+    stream = body-8;
+
+    if(n > max || rice_decode(dst, n, &frame[header+3], stream, *channels) != stream)
+        return 0;
+
+    return n;
+}
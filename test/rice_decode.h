@@ -0,0 +1,12 @@
+#ifndef TEST_RICE_DECODE_H
+#define TEST_RICE_DECODE_H
+/*INCLUDES********************************************************************************************/
+#include "stdint.h"
+
+/*PROTOTYPES******************************************************************************************/
+//Host reference decoder of the compressed upload format, specification in frame_rice_encode (Scr/frame.c)
+uint32_t rice_decode(uint16_t *dst, uint32_t n, const uint8_t *src, uint32_t len, uint8_t channels);
+uint32_t rice_decode_frame(uint16_t *dst, uint32_t max, uint8_t *channels, char *curve_type,
+                                const uint8_t *frame, uint32_t len);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef TEST_TEST_H
+#define TEST_TEST_H
+/*INCLUDES********************************************************************************************/
+#include "stdio.h"
+#include "stdlib.h"
+
+/*DEFINES*********************************************************************************************/
+//Host tests: a failed check prints its location and the test exits with 1
+#define CHECK(cond)                                                                     \
+    do{                                                                                 \
+        if(!(cond))                                                                     \
+        {                                                                               \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);             \
+            exit(1);                                                                    \
+        }                                                                               \
+    }while(0)
+
+#define TEST_PASS()                 printf("%s: pass\n", __FILE__)
+
+#endif
@@ -0,0 +1,122 @@
+/*INCLUDES********************************************************************************************/
+#include "string.h"
+
+#include "test.h"
+#include "command.h"
+
+/*DEFINES*********************************************************************************************/
+#define FRAME_MAX_SIZE              128
+#define FUZZ_ROUNDS                 200000
+
+/*PROTOTYPES******************************************************************************************/
+static bool parse_body(command_t *command, const char *body);
+static uint32_t format_frame(char *dst, const command_t *command);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Wrap a body "<cmd>[,<args>]" as "QT:<len>;<body>." and parse it.
+ */
+static bool parse_body(command_t *command, const char *body)
+{
+    char frame[FRAME_MAX_SIZE];
+
+    snprintf(frame, sizeof(frame), "QT:%u;%s.", (unsigned)strlen(body), body);
+    return command_parse(command, frame);
+}
+
+/*  \brief  Frame that command_parse must decode back to command.
+ *
+ *  \return Size of frame.
+ *
+ */
+static uint32_t format_frame(char *dst, const command_t *command)
+{
+    char body[FRAME_MAX_SIZE];
+    uint32_t size;
+
+    size = snprintf(body, sizeof(body), "%c", command->cmd);
+    for(uint8_t i=0; i<command->argc; i++)
+        size += snprintf(&body[size], sizeof(body)-size, "%c%lu", i ? '-' : ',', (unsigned long)command->argv[i]);
+
+    return snprintf(dst, FRAME_MAX_SIZE, "QT:%lu;%s.", (unsigned long)size, body);
+}
+
+/*  \brief  Host tests of command_parse: field limits, framing errors, and a fuzz pass with random bytes
+ *          and mutated valid frames.
+ */
+int main()
+{
+    command_t command, decoded;
+    char frame[FRAME_MAX_SIZE];
+    uint32_t size;
+
+    //Command without arguments
+    CHECK(parse_body(&command, "c"));
+    CHECK(command.cmd == 'c' && command.argc == 0);
+    CHECK(command_parse(&command, "QT:1;0."));
+
+    //Empty argument list and empty fields
+    CHECK(!parse_body(&command, "a,"));
+    CHECK(!parse_body(&command, "a,1-"));
+    CHECK(!parse_body(&command, "a,-1"));
+    CHECK(!parse_body(&command, "a,1--2"));
+
+    //32-bit range: 4294967295 is the last value, one more overflows
+    CHECK(parse_body(&command, "k,4294967295"));
+    CHECK(command.argc == 1 && command.argv[0] == 0xFFFFFFFF);
+    CHECK(parse_body(&command, "k,4294967290-0-00004294967295"));
+    CHECK(command.argc == 3 && command.argv[0] == 4294967290u && command.argv[2] == 0xFFFFFFFF);
+    CHECK(!parse_body(&command, "k,4294967296"));
+    CHECK(!parse_body(&command, "k,4294967300"));
+    CHECK(!parse_body(&command, "k,99999999999"));
+
+    //COMMAND_MAX_ARGS fit, one more does not
+    CHECK(parse_body(&command, "m,1-2-3-4-5-6-7-8"));
+    CHECK(command.argc == COMMAND_MAX_ARGS && command.argv[7] == 8);
+    CHECK(!parse_body(&command, "m,1-2-3-4-5-6-7-8-9"));
+
+    //Framing: length, prefix, terminator
+    CHECK(!command_parse(&command, "QT:2;c."));
+    CHECK(!command_parse(&command, "QT:0;c."));
+    CHECK(!command_parse(&command, "QT:;c."));
+    CHECK(!command_parse(&command, "QT:1;c"));
+    CHECK(!command_parse(&command, "QX:1;c."));
+    CHECK(!command_parse(&command, "QT:1;."));
+    CHECK(!command_parse(&command, "QT:1;,."));
+    CHECK(!command_parse(&command, "QT:4;a,1x."));
+    CHECK(!command_parse(&command, "QT:99999;c."));
+    CHECK(!command_parse(&command, ""));
+
+    srand(1);
+    for(uint32_t r=0; r<FUZZ_ROUNDS; r++)
+    {
+        //Random bytes, mostly from the frame alphabet so the parser gets past the prefix
+        size = rand()%(FRAME_MAX_SIZE-1);
+        for(uint32_t i=0; i<size; i++)
+            frame[i] = rand()%4 ? "QT:;,-.0123456789abc"[rand()%20] : rand()%255+1;
+        frame[size] = '\0';
+        if(command_parse(&command, frame))
+            CHECK(command.argc <= COMMAND_MAX_ARGS);
+
+        //Valid frame round trip, then one byte changed or the frame cut short
+        command.cmd = 'a'+rand()%26;
+        command.argc = rand()%(COMMAND_MAX_ARGS+1);
+        for(uint8_t i=0; i<command.argc; i++)
+            command.argv[i] = (uint32_t)rand() << 16 ^ rand();
+        size = format_frame(frame, &command);
+
+        CHECK(command_parse(&decoded, frame));
+        CHECK(decoded.cmd == command.cmd && decoded.argc == command.argc);
+        CHECK(memcmp(decoded.argv, command.argv, command.argc*sizeof(command.argv[0])) == 0);
+
+        if(rand()%2)
+            frame[rand()%size] = rand()%255+1;
+        else
+            frame[rand()%size] = '\0';
+        if(command_parse(&decoded, frame))
+            CHECK(decoded.argc <= COMMAND_MAX_ARGS);
+    }
+
+    TEST_PASS();
+    return 0;
+}
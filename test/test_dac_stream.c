@@ -0,0 +1,71 @@
+/*INCLUDES********************************************************************************************/
+#include "test.h"
+#include "hal.h"
+#include "ramp.h"
+
+/*DEFINES*********************************************************************************************/
+#define DAC_1_DIR                   0x60
+#define STEPS                       400
+#define SYS_MHZ                     130
+#define STEP_MIN_US                 25          //DAC_STEP_MIN_US and DAC_STEP_MAX_US of main.c
+#define STEP_MAX_US                 1000
+#define STEP_TOLERANCE_US           1           //Log is kept in whole us
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint16_t values[STEPS];
+static uint16_t stream[2*STEPS];
+static hal_sim_dac_update_t updates[STEPS+1];
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Timer paced DAC stream on the simulation backend: one update per step, in order, step_us
+ *          apart, for the ends and the middle of the accepted step range.
+ */
+int main()
+{
+    const uint32_t step_us[] = {STEP_MIN_US, 50, 200, STEP_MAX_US};
+    uint32_t words, len, start, remaining;
+    int64_t interval;
+
+    //Pacing timer divider is 16-bit
+    CHECK(HAL_DAC_STREAM_DIVIDER(SYS_MHZ, STEP_MAX_US) <= 0xFFFF);
+
+    ramp_generate(values, STEPS, RAMP_MAX_CODE, RAMP_LINEAR, 0);
+    words = ramp_dac_stream(stream, values, STEPS);
+    CHECK(words == 2*STEPS);
+    for(uint32_t i=0; i<words; i++)
+        CHECK(!(stream[i] & HAL_DAC_STREAM_STOP) == (i != words-1));
+
+    hal_dac_stream_init(STEP_MIN_US);
+    for(uint8_t s=0; s<sizeof(step_us)/sizeof(step_us[0]); s++)
+    {
+        hal_dac_stream_set_step(step_us[s]);
+        start = hal_get_stats().time_us;
+        hal_dac_stream_start(DAC_1_DIR, stream, words);
+
+        //Half way, about half of the words have been moved
+        hal_delay_us(STEPS*step_us[s]/2);
+        remaining = hal_dac_stream_remaining();
+        CHECK(remaining >= words/2-2 && remaining <= words/2+2);
+
+        hal_dac_stream_wait();
+        CHECK(hal_dac_stream_remaining() == 0);
+        CHECK(hal_get_stats().time_us - start >= STEPS*step_us[s]);
+
+        len = hal_sim_dac_updates(updates, STEPS+1);
+        CHECK(len == STEPS);
+        for(uint32_t i=0; i<len; i++)
+        {
+            CHECK(updates[i].addr == DAC_1_DIR);
+            CHECK(updates[i].code == values[i]);
+            if(i == 0)
+                continue;
+
+            interval = (int64_t)(updates[i].time_us - updates[i-1].time_us);
+            CHECK(interval >= (int64_t)step_us[s]-STEP_TOLERANCE_US && interval <= step_us[s]+STEP_TOLERANCE_US);
+        }
+    }
+
+    TEST_PASS();
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*INCLUDES********************************************************************************************/
+#include "string.h"
+#include "time.h"
+
+#include "test.h"
+#include "frame.h"
+
+/*DEFINES*********************************************************************************************/
+#define CAPTURE_SIZE                19100       //ADC_SIZE_BUFFER of main.c
+#define BENCH_ROUNDS                200
+#define UART_BAUDRATE               115200      //Compatibility rate, UART_BAUDRATE of main.c
+#define UART_MAX_BAUDRATE           1000000     //Highest rate accepted by 'd'
+#define UART_BITS_PER_BYTE          10          //8N1
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint16_t capture[CAPTURE_SIZE];
+static uint8_t frame[FRAME_ADC_MAX_SIZE(CAPTURE_SIZE)];
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Host throughput of the upload framing: a synthetic capture goes through frame_build_adc,
+ *          the frame is checked field by field and the build time is compared with the wire time.
+ */
+int main()
+{
+    struct timespec t0, t1;
+    uint32_t size, frame_size, header, n = CAPTURE_SIZE;
+    unsigned long len;
+    char type;
+    int body = 0;
+    uint16_t a, b;
+    double us;
+
+    //Interleaved VCE and IC channels of a smooth curve, full 12-bit range
+    for(uint32_t i=0; i<n; i+=2)
+    {
+        capture[i] = i*4095/n;
+        capture[i+1] = (i*i/n)*4095/n;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(uint32_t r=0; r<BENCH_ROUNDS; r++)
+        size = frame_build_adc(frame, capture, n, 'e');
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    us = ((t1.tv_sec-t0.tv_sec)*1e6 + (t1.tv_nsec-t0.tv_nsec)/1e3)/BENCH_ROUNDS;
+
+    //"RP:<len>;e,<packed>end", len counts from the type to the tail
+    CHECK(sscanf((const char *)frame, "RP:%lu;%c,%n", &len, &type, &body) == 2);
+    header = body;
+    CHECK(type == 'e');
+    CHECK(len == FRAME_PACKED_SIZE(n)+5);
+    CHECK(size == header+FRAME_PACKED_SIZE(n)+FRAME_TAIL_SIZE);
+    CHECK(size <= FRAME_ADC_MAX_SIZE(n));
+    CHECK(memcmp(&frame[size-FRAME_TAIL_SIZE], frame_tail, FRAME_TAIL_SIZE) == 0);
+    frame_size = size;
+
+    for(uint32_t i=0; i<n; i+=2)
+    {
+        a = frame[header+i/2*3] | (frame[header+i/2*3+1] & 0xF0) << 4;
+        b = (frame[header+i/2*3+1] & 0x0F) << 8 | frame[header+i/2*3+2];
+        CHECK(a == capture[i] && b == capture[i+1]);
+    }
+
+    //Odd counts are padded with a zero sample
+    size = frame_build_adc(frame, capture, 3, 'f');
+    CHECK(size == strlen("RP:11;f,")+FRAME_PACKED_SIZE(3)+FRAME_TAIL_SIZE);
+    CHECK(frame[strlen("RP:11;f,")+5] == 0);
+
+    printf("frame_build_adc: %u samples, %u B frame, %.1f us (%.4f us/sample, %.1f MB/s)\n", n,
+            frame_size, us, us/n, frame_size/us);
+    printf("wire time: %.0f ms at %u baud, %.0f ms at %u baud\n",
+            frame_size*UART_BITS_PER_BYTE*1000.0/UART_BAUDRATE, UART_BAUDRATE,
+            frame_size*UART_BITS_PER_BYTE*1000.0/UART_MAX_BAUDRATE, UART_MAX_BAUDRATE);
+
+    TEST_PASS();
+    return 0;
+}
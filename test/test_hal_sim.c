@@ -0,0 +1,53 @@
+/*INCLUDES********************************************************************************************/
+#include "test.h"
+#include "hal.h"
+
+/*DEFINES*********************************************************************************************/
+#define DAC_1_DIR                   0x60
+#define DAC_2_DIR                   0x61
+#define RELE_PIN                    15
+#define OPA_ENA_PIN                 21
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Simulation backend smoke test: DAC writes reach the DUT model, traffic and virtual time are
+ *          counted, and the UART does not block without a pty.
+ */
+int main()
+{
+    uint8_t code[2];
+    uint16_t low, high;
+    hal_stats_t stats;
+
+    CHECK(hal_i2c_probe(DAC_1_DIR, 100));
+    CHECK(!hal_i2c_probe(0x10, 100));
+
+    //VBE mode: base supply from DAC2, channel 2 reads VBE
+    hal_gpio_put(OPA_ENA_PIN, true);
+    hal_gpio_put(RELE_PIN, true);
+    hal_adc_select(2);
+
+    code[0] = 0x01; code[1] = 0x00;
+    CHECK(hal_i2c_write(DAC_2_DIR, code, 2) == 2);
+    low = hal_adc_read();
+
+    code[0] = 0x0F; code[1] = 0xFF;
+    hal_i2c_write(DAC_2_DIR, code, 2);
+    high = hal_adc_read();
+
+    //VBE of a diode junction: rises with the base drive, stays well below the supply
+    CHECK(high > low);
+    CHECK(high < HAL_ADC_MAX_CODE/3);
+
+    hal_uart_write((const uint8_t *)"end", 3);
+    hal_delay_us(1000);
+
+    stats = hal_get_stats();
+    CHECK(stats.i2c_bytes == 4);
+    CHECK(stats.adc_samples == 2);
+    CHECK(stats.uart_tx_bytes == 3);
+    CHECK(stats.time_us >= 1000);
+
+    TEST_PASS();
+    return 0;
+}
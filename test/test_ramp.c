@@ -0,0 +1,123 @@
+/*INCLUDES********************************************************************************************/
+#include "time.h"
+
+#include "test.h"
+#include "ramp.h"
+
+/*DEFINES*********************************************************************************************/
+//Defaults of main.c before the integer generator: 40 ms sweep, one step every 200 us
+#define PERIOD_US                   40000
+#define ELAPCED_US                  200
+#define DAC_SIZE_BUFFER             (PERIOD_US/ELAPCED_US) +1
+#define VBE_AMPLITUDE               1241        //0.3030 of full scale, DAC_VBE_AMPLITUDE of main.c
+#define BENCH_ROUNDS                20000
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint16_t float_values[DAC_SIZE_BUFFER];
+static uint16_t values[DAC_SIZE_BUFFER];
+
+/*PROTOTYPES******************************************************************************************/
+static void float_ramp(uint16_t *dst, float amp);
+static double elapsed_us(const struct timespec *t0, const struct timespec *t1);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  generate_ramp as it was before ramp_generate, amp is the fraction of full scale.
+ */
+static void float_ramp(uint16_t *dst, float amp)
+{
+    float time = 0;
+
+    for(uint16_t i=0; i<DAC_SIZE_BUFFER; i++)
+    {
+        dst[i] = (((float)amp/(float)PERIOD_US)*time)*4095;
+        time += ELAPCED_US;
+    }
+}
+
+static double elapsed_us(const struct timespec *t0, const struct timespec *t1)
+{
+    return (t1->tv_sec-t0->tv_sec)*1e6 + (t1->tv_nsec-t0->tv_nsec)/1e3;
+}
+
+/*  \brief  ramp_generate against the float generator it replaced: same linear ramps within the float
+ *          truncation, every profile ends where it should, and the time per ramp of both.
+ */
+int main()
+{
+    const uint8_t percent[] = {10, 33, 50, 100};
+    struct timespec t0, t1;
+    volatile uint16_t sink = 0;
+    double float_us, int_us;
+    int32_t diff;
+
+    //Float version truncates, the Q16.16 accumulator rounds: at most 1 LSB apart
+    for(uint8_t p=0; p<sizeof(percent); p++)
+    {
+        float_ramp(float_values, percent[p]/100.0f);
+        ramp_generate(values, DAC_SIZE_BUFFER, percent[p]*RAMP_MAX_CODE/100, RAMP_LINEAR, 0);
+        for(uint16_t i=0; i<DAC_SIZE_BUFFER; i++)
+        {
+            diff = (int32_t)values[i] - float_values[i];
+            CHECK(diff >= -1 && diff <= 1);
+        }
+    }
+
+    float_ramp(float_values, 0.3030f);
+    ramp_generate(values, DAC_SIZE_BUFFER, VBE_AMPLITUDE, RAMP_LINEAR, 0);
+    for(uint16_t i=0; i<DAC_SIZE_BUFFER; i++)
+    {
+        diff = (int32_t)values[i] - float_values[i];
+        CHECK(diff >= -1 && diff <= 1);
+    }
+
+    //Other profiles: log and stair end at the amplitude, triangle comes back to 0
+    ramp_generate(values, DAC_SIZE_BUFFER, RAMP_MAX_CODE, RAMP_LOG, 0);
+    CHECK(values[0] == 0 && values[DAC_SIZE_BUFFER-1] == RAMP_MAX_CODE);
+    for(uint16_t i=1; i<DAC_SIZE_BUFFER; i++)
+        CHECK(values[i] >= values[i-1]);
+
+    ramp_generate(values, DAC_SIZE_BUFFER, RAMP_MAX_CODE, RAMP_STAIR, 8);
+    CHECK(values[DAC_SIZE_BUFFER-1] == RAMP_MAX_CODE);
+
+    ramp_generate(values, DAC_SIZE_BUFFER, RAMP_MAX_CODE, RAMP_TRIANGLE, 0);
+    CHECK(values[0] == 0 && values[DAC_SIZE_BUFFER-1] == 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(uint32_t r=0; r<BENCH_ROUNDS; r++)
+    {
+        float_ramp(float_values, (r%100+1)/100.0f);
+        sink += float_values[r%DAC_SIZE_BUFFER];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    float_us = elapsed_us(&t0, &t1)/BENCH_ROUNDS;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(uint32_t r=0; r<BENCH_ROUNDS; r++)
+    {
+        ramp_generate(values, DAC_SIZE_BUFFER, (r%100+1)*RAMP_MAX_CODE/100, RAMP_LINEAR, 0);
+        sink += values[r%DAC_SIZE_BUFFER];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int_us = elapsed_us(&t0, &t1)/BENCH_ROUNDS;
+
+    //The host has an FPU, on the Cortex-M0+ every float operation of the old version is a soft-float call
+    printf("%u points: float %.3f us, ramp_generate %.3f us per ramp (host, %.1fx)\n", DAC_SIZE_BUFFER,
+            float_us, int_us, float_us/int_us);
+
+    for(uint8_t p=RAMP_LINEAR; p<=RAMP_TRIANGLE; p++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for(uint32_t r=0; r<BENCH_ROUNDS; r++)
+        {
+            ramp_generate(values, DAC_SIZE_BUFFER, (r%100+1)*RAMP_MAX_CODE/100, p, 8);
+            sink += values[r%DAC_SIZE_BUFFER];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("profile %u: %.3f us per ramp\n", p, elapsed_us(&t0, &t1)/BENCH_ROUNDS);
+    }
+
+    (void)sink;
+    TEST_PASS();
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*INCLUDES********************************************************************************************/
+#include "string.h"
+#include "time.h"
+
+#include "test.h"
+#include "hal.h"
+#include "frame.h"
+#include "rice_decode.h"
+
+/*DEFINES*********************************************************************************************/
+//Defaults of main.c: 40 ms sweep of 200 DAC steps, 19100 samples of 2 channels
+#define CAPTURE_SIZE                19100
+#define CHANNELS                    2
+#define DAC_STEPS                   200
+#define DAC_1_DIR                   0x60
+#define DAC_2_DIR                   0x61
+#define RELE_PIN                    15
+#define OPA_ENA_PIN                 21
+#define POT_WRITE_CMD               0x11
+#define BENCH_ROUNDS                50
+#define UART_BYTE_US                (10*1000000.0/115200)   //8N1 at 115200 baud
+#define RATIO_MIN                   2.0                     //Smooth curves must compress at least 2:1
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint16_t capture[CAPTURE_SIZE];
+static uint16_t decoded[CAPTURE_SIZE];
+static uint8_t packed[FRAME_ADC_MAX_SIZE(CAPTURE_SIZE)];
+static uint8_t rice[FRAME_ADC_MAX_SIZE(CAPTURE_SIZE)];
+
+/*PROTOTYPES******************************************************************************************/
+static void sim_capture(bool vbe, uint8_t pot);
+static uint32_t load_capture(const char *path);
+static double bench(const char *name, uint32_t n);
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Record a default sweep from the simulation backend: DAC ramp, both channels read in turn.
+ *
+ *  \param  vbe     true for a VBE curve (relay on, DAC2), false for VCE (DAC1).
+ *  \param  pot     Base drive of VCE curves.
+ *
+ */
+static void sim_capture(bool vbe, uint8_t pot)
+{
+    uint8_t buffer[2];
+    uint16_t code;
+    uint32_t step, last = DAC_STEPS;
+
+    hal_gpio_put(OPA_ENA_PIN, true);
+    hal_gpio_put(RELE_PIN, vbe);
+    buffer[0] = POT_WRITE_CMD;
+    buffer[1] = pot;
+    hal_spi_write(buffer, 2);
+
+    for(uint32_t i=0; i<CAPTURE_SIZE; i+=CHANNELS)
+    {
+        step = (uint64_t)i*DAC_STEPS/CAPTURE_SIZE;
+        if(step != last)
+        {
+            code = step*HAL_ADC_MAX_CODE/(DAC_STEPS-1);
+            buffer[0] = code >> 8;
+            buffer[1] = code;
+            hal_i2c_write(vbe ? DAC_2_DIR : DAC_1_DIR, buffer, 2);
+            last = step;
+        }
+
+        for(uint8_t c=0; c<CHANNELS; c++)
+        {
+            hal_adc_select(c);
+            capture[i+c] = hal_adc_read();
+        }
+    }
+}
+
+/*  \brief  Load a recorded capture: raw little endian 16-bit samples, CHANNELS interleaved.
+ *
+ *  \return Number of samples.
+ *
+ */
+static uint32_t load_capture(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t sample[2];
+    uint32_t n = 0;
+
+    CHECK(f != NULL);
+    while(n < CAPTURE_SIZE && fread(sample, 2, 1, f) == 1)
+        capture[n++] = (sample[0] | sample[1] << 8) & 0x0FFF;
+    fclose(f);
+
+    return n - n%CHANNELS;
+}
+
+/*  \brief  Round trip one capture through both frame formats and time the encoder.
+ *
+ *  \param  name    Label of the capture.
+ *  \param  n       Number of samples.
+ *
+ *  \return Compression ratio against the packed frame, 1 if the packed frame is sent instead.
+ *
+ */
+static double bench(const char *name, uint32_t n)
+{
+    struct timespec t0, t1;
+    uint32_t packed_size, rice_size, len;
+    uint8_t channels;
+    char type;
+    double us;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(uint32_t i=0; i<BENCH_ROUNDS; i++)
+        frame_rice_encode(rice, FRAME_PACKED_SIZE(n), capture, n, CHANNELS);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    us = ((t1.tv_sec-t0.tv_sec)*1e6 + (t1.tv_nsec-t0.tv_nsec)/1e3)/BENCH_ROUNDS/n;
+
+    packed_size = frame_build_adc(packed, capture, n, 'e');
+    rice_size = frame_build_adc_rice(rice, capture, n, CHANNELS, 'e');
+
+    //Encoder declines when it would not save anything, the firmware then sends the packed frame
+    if(rice_size == 0)
+    {
+        printf("%-12s %6u samples  packed %6u B  rice  (falls back)   %.4f us/sample\n", name, n, packed_size,
+                us);
+        return 1;
+    }
+
+    memset(decoded, 0xFF, sizeof(decoded));
+    len = rice_decode_frame(decoded, CAPTURE_SIZE, &channels, &type, rice, rice_size);
+    CHECK(len == n);
+    CHECK(channels == CHANNELS);
+    CHECK(type == 'e');
+    CHECK(memcmp(decoded, capture, n*sizeof(capture[0])) == 0);
+
+    printf("%-12s %6u samples  packed %6u B  rice %6u B  %.2f:1  %5.0f ms -> %4.0f ms  %.4f us/sample\n",
+            name, n, packed_size, rice_size, (double)packed_size/rice_size, packed_size*UART_BYTE_US/1000,
+            rice_size*UART_BYTE_US/1000, us);
+
+    return (double)packed_size/rice_size;
+}
+
+/*  \brief  Host reference decoder against frame_rice_encode on simulated sweeps, noise and escapes,
+ *          plus ratio and encode time. Recorded captures given as arguments are benchmarked too.
+ */
+int main(int argc, char **argv)
+{
+    const uint8_t pots[] = {32, 96, 200};
+    char name[16];
+    uint32_t n;
+
+    srand(1);
+
+    for(uint8_t i=0; i<sizeof(pots); i++)
+    {
+        sim_capture(false, pots[i]);
+        snprintf(name, sizeof(name), "vce pot %u", pots[i]);
+        CHECK(bench(name, CAPTURE_SIZE) >= RATIO_MIN);
+    }
+
+    sim_capture(true, 0);
+    CHECK(bench("vbe", CAPTURE_SIZE) >= RATIO_MIN);
+
+    //Full scale spikes on a slow ramp take the escape path
+    for(uint32_t i=0; i<CAPTURE_SIZE; i++)
+        capture[i] = i%97 ? i*HAL_ADC_MAX_CODE/CAPTURE_SIZE : HAL_ADC_MAX_CODE;
+    n = frame_rice_encode(rice, sizeof(rice), capture, CAPTURE_SIZE, CHANNELS);
+    CHECK(n > 0);
+    CHECK(rice_decode(decoded, CAPTURE_SIZE, rice, n, CHANNELS) == n);
+    CHECK(memcmp(decoded, capture, sizeof(capture)) == 0);
+
+    //White noise does not compress, the frame builder must decline
+    for(uint32_t i=0; i<CAPTURE_SIZE; i++)
+        capture[i] = rand() & 0x0FFF;
+    CHECK(bench("noise", CAPTURE_SIZE) == 1);
+
+    //Odd lengths and a partial last block
+    sim_capture(false, 96);
+    CHECK(bench("vce short", 2*FRAME_RICE_BLOCK*CHANNELS+CHANNELS) >= 1);
+
+    for(int i=1; i<argc; i++)
+    {
+        n = load_capture(argv[i]);
+        bench(argv[i], n);
+    }
+
+    TEST_PASS();
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*INCLUDES********************************************************************************************/
+#include "string.h"
+
+#include "test.h"
+#include "ring.h"
+#include "frame.h"
+#include "command.h"
+
+/*DEFINES*********************************************************************************************/
+#define RING_SIZE                   256         //UART_RX_RING_SIZE of main.c
+#define STREAM_FRAMES               2000
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint8_t storage[RING_SIZE];
+static char stream[STREAM_FRAMES*24];
+
+/*FUNCTIONS*******************************************************************************************/
+
+/*  \brief  Host tests of the UART RX path: the byte ring as the IRQ and serial_receive_task use it, and
+ *          frame_rx_feed on streams split at arbitrary points.
+ */
+int main()
+{
+    ring_t ring;
+    frame_rx_t frame = {0};
+    command_t command;
+    uint8_t data;
+    uint32_t len = 0, sent = 0, chunk, frames = 0, overflows = 0;
+    uint32_t expected = 0, expected_overflows = 0;
+
+    //Empty and full
+    ring_init(&ring, storage, RING_SIZE);
+    CHECK(!ring_get(&ring, &data));
+    for(uint16_t i=0; i<RING_SIZE; i++)
+        CHECK(ring_put(&ring, i));
+    CHECK(ring_count(&ring) == RING_SIZE);
+    CHECK(!ring_put(&ring, 0xAA));
+    for(uint16_t i=0; i<RING_SIZE; i++)
+    {
+        CHECK(ring_get(&ring, &data));
+        CHECK(data == (uint8_t)i);
+    }
+    CHECK(!ring_get(&ring, &data));
+    CHECK(ring_count(&ring) == 0);
+
+    //Wraparound of the storage and of the 16-bit head/tail counters, FIFO order kept throughout
+    ring.head = ring.tail = 0xFFFF - 100;
+    for(uint32_t i=0; i<3*65536; i++)
+    {
+        CHECK(ring_put(&ring, i*7));
+        if(i%3 == 0)
+            CHECK(ring_put(&ring, i*7+1));
+        CHECK(ring_get(&ring, &data) && data == (uint8_t)(i*7));
+        if(i%3 == 0)
+            CHECK(ring_get(&ring, &data) && data == (uint8_t)(i*7+1));
+        CHECK(ring_count(&ring) == 0);
+    }
+
+    //Frames with noise between them, one restarted by a new 'Q' and one longer than FRAME_RX_MAX_SIZE
+    srand(1);
+    for(uint32_t f=0; f<STREAM_FRAMES; f++)
+    {
+        if(f%97 == 0)
+            len += sprintf(&stream[len], "QT:9;a,1-2");
+        else if(f%101 == 0)
+        {
+            memset(&stream[len], '7', FRAME_RX_MAX_SIZE);
+            len += FRAME_RX_MAX_SIZE;
+            expected_overflows++;
+        }
+        else if(f%5 == 0)
+            len += sprintf(&stream[len], "\r\n");
+
+        //Body "k,<f>-7"
+        len += sprintf(&stream[len], "QT:%u;k,%u-7.", 5+(f >= 10)+(f >= 100)+(f >= 1000), f);
+        expected++;
+    }
+
+    //Split at random points: the IRQ fills the ring, the task drains it when it wakes up
+    while(sent < len)
+    {
+        chunk = rand()%RING_SIZE+1;
+        for(uint32_t i=0; i<chunk && sent < len; i++)
+            CHECK(ring_put(&ring, stream[sent++]));
+
+        while(ring_get(&ring, &data))
+        {
+            switch(frame_rx_feed(&frame, data))
+            {
+                case FRAME_RX_COMPLETE:
+                    CHECK(command_parse(&command, frame.buffer));
+                    CHECK(command.cmd == 'k' && command.argc == 2);
+                    CHECK(command.argv[0] == frames && command.argv[1] == 7);
+                    frames++;
+                    break;
+
+                case FRAME_RX_OVERFLOW:
+                    overflows++;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    CHECK(frames == expected);
+    CHECK(overflows == expected_overflows);
+    CHECK(frame.index == 0);
+
+    TEST_PASS();
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*INCLUDES********************************************************************************************/
+#include "stddef.h"
+
+#include "test.h"
+#include "hal.h"
+#include "screen.h"
+
+/*DEFINES*********************************************************************************************/
+#define FRAMES                      10
+#define PAGE_TRANSFER_SIZE          (OLED_ROW_SIZE+7)       //Address commands, 0x40 and one page of data
+
+/*GLOBAL VARIABLES************************************************************************************/
+static uint32_t allocations;
+
+//Scr/fonts.c holds no table yet, blank glyphs for printable ASCII are enough to drive the transfers
+const uint8_t font_8_table[96*6];
+
+/*PROTOTYPES******************************************************************************************/
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+/*FUNCTIONS*******************************************************************************************/
+
+//Linked with --wrap, every heap call from the driver lands here
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    allocations++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    allocations++;
+    __real_free(ptr);
+}
+
+//FreeRTOS heap, defined here so a call from the driver links and is counted
+void *pvPortMalloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    allocations++;
+    __real_free(ptr);
+}
+
+/*  \brief  Draw the gui_task frame (plot, progress bar, text) and flush it, as often as FRAMES.
+ */
+static void draw_frame(uint8_t n)
+{
+    oled_fill_rect(0, 8, OLED_WIDTH_SIZE, OLED_HEIGHT_SIZE, false);
+    for(uint8_t x=1; x<OLED_WIDTH_SIZE; x++)
+        oled_draw_line(x-1, OLED_HEIGHT_SIZE-1 - (x-1)*n%56, x, OLED_HEIGHT_SIZE-1 - x*n%56);
+
+    oled_fill_rect(0, 0, OLED_WIDTH_SIZE*n/FRAMES, 4, true);
+    oled_fill_rect(OLED_WIDTH_SIZE*n/FRAMES, 0, OLED_WIDTH_SIZE, 4, false);
+    oled_draw_string("VCE", 0, 56);
+    oled_flush();
+}
+
+int main()
+{
+    hal_stats_t before, after;
+
+    oled_init();
+
+    //Panel RAM is unknown after power up, the first clear writes every page once
+    before = hal_get_stats();
+    oled_clear();
+    after = hal_get_stats();
+    CHECK(after.i2c_bytes - before.i2c_bytes == OLED_PAGE_SIZE*PAGE_TRANSFER_SIZE);
+
+    //Full refresh: one transaction per page, no per-column commands
+    before = hal_get_stats();
+    oled_refresh();
+    after = hal_get_stats();
+    CHECK(after.i2c_bytes - before.i2c_bytes == OLED_PAGE_SIZE*PAGE_TRANSFER_SIZE);
+
+    allocations = 0;
+    for(uint8_t n=1; n<=FRAMES; n++)
+    {
+        draw_frame(n);
+        CHECK(allocations == 0);
+    }
+
+    //Nothing changed since the last flush, nothing is sent
+    before = hal_get_stats();
+    oled_flush();
+    after = hal_get_stats();
+    CHECK(after.i2c_bytes == before.i2c_bytes);
+
+    TEST_PASS();
+    return 0;
+}